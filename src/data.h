@@ -8,6 +8,8 @@
 
 #include <vector>
 #include <cstdio>
+#include <cstring>
+#include <inttypes.h>
 
 namespace xgboost{
 /*! \brief interger type used in boost */
@@ -41,31 +43,125 @@ struct IFMatrix {
         return a.fvalue < b.fvalue;
     }
   };
-  /*! \brief row iterator */
+  /*! 
+   * \brief row iterator, iterates entries stored as REntry,
+   *        or a dense row of values where NaN marks missing value
+   */
   struct RowIter{
-    const REntry *dptr_, *end_;
+    /*! \brief constructor of iterator over sparse entries */
     RowIter( const REntry* dptr, const REntry* end )
-        :dptr_(dptr),end_(end){}
+        :dptr_(dptr), end_(end), fptr_(NULL), fend_(0), findex_(0), fvalue_(0.0f){}
+    /*! 
+     * \brief constructor of iterator over dense row
+     * \param fptr start of the row
+     * \param ncol number of values in the row
+     */
+    RowIter( const bst_float *fptr, size_t ncol )
+        :dptr_(NULL), end_(NULL), fptr_(fptr), fend_(static_cast<bst_uint>(ncol)),
+         findex_(static_cast<bst_uint>(-1)), fvalue_(0.0f){}
     inline bool Next( void ){
-        if( dptr_ == end_ ) return false;
-        else{
-           ++ dptr_; return true;
+        if( fptr_ == NULL ){
+            if( dptr_ == end_ ) return false;
+            ++ dptr_; findex_ = dptr_->findex; fvalue_ = dptr_->fvalue;
+            return true;
         }
+        while( ++ findex_ < fend_ ){
+            fvalue_ = fptr_[ findex_ ];
+            if( fvalue_ == fvalue_ ) return true;
+        }
+        -- findex_;
+        return false;
     }
     inline bst_uint  findex( void ) const{
-        return dptr_->findex;
+        return findex_;
     }
     inline bst_float fvalue( void ) const{
-        return dptr_->fvalue;
+        return fvalue_;
     }
+   private:
+    // sparse entries
+    const REntry *dptr_, *end_;
+    // dense row
+    const bst_float *fptr_;
+    bst_uint fend_;
+    // current entry
+    bst_uint findex_;
+    bst_float fvalue_;
   };
-  /*! \brief column iterator */
-  struct ColIter: public RowIter{
+  /*! 
+   * \brief column iterator, iterates entries either stored as REntry,
+   *        or stored in compressed form and decoded on the fly:
+   *        row indices are bit-packed, absolute or zigzag delta encoded,
+   *        values are distinct values of the column with bit-packed run lengths
+   */
+  struct ColIter {
+    /*! \brief constructor of iterator over plain entries */
     ColIter( const REntry* dptr, const REntry* end )
-        :RowIter( dptr, end ){}
+        :dptr_(dptr), end_(end), rows_(NULL), rindex_(0), fvalue_(0.0f) {}
+    /*!
+     * \brief constructor of iterator over compressed column
+     * \param rows packed row indices
+     * \param row_bits bit width of each row index
+     * \param delta whether row indices are zigzag delta encoded
+     * \param runs packed run length minus one of each distinct value
+     * \param run_bits bit width of each run length
+     * \param values distinct values of the column, in increasing order
+     * \param length number of entries in the column
+     */
+    ColIter( const unsigned char *rows, unsigned row_bits, bool delta,
+             const unsigned char *runs, unsigned run_bits,
+             const bst_float *values, size_t length )
+        :dptr_(NULL), end_(NULL), rows_(rows), runs_(runs), values_(values),
+         row_pos_(0), run_pos_(0), row_bits_(row_bits), run_bits_(run_bits), delta_(delta),
+         left_(length), run_left_(0), rindex_(0), fvalue_(0.0f) {}
+    inline bool Next( void ){
+        if( rows_ == NULL ){
+            if( dptr_ == end_ ) return false;
+            ++ dptr_; rindex_ = dptr_->findex; fvalue_ = dptr_->fvalue;
+            return true;
+        }
+        if( left_ == 0 ) return false;
+        -- left_;
+        if( run_left_ == 0 ){
+            fvalue_ = *values_ ++;
+            run_left_ = ReadBits( runs_, run_pos_, run_bits_ ) + 1;
+            run_pos_ += run_bits_;
+        }
+        -- run_left_;
+        const unsigned v = ReadBits( rows_, row_pos_, row_bits_ );
+        row_pos_ += row_bits_;
+        rindex_ = delta_ ? rindex_ + ( ( v >> 1 ) ^ ( 0U - ( v & 1U ) ) ) : v;
+        return true;
+    }
     inline bst_uint  rindex( void ) const{
-        return this->findex();
+        return rindex_;
+    }
+    inline bst_float fvalue( void ) const{
+        return fvalue_;
+    }
+    /*! 
+     * \brief read an integer of nbits bits at bit position pos, 
+     *        the packed stream must be followed by 8 bytes of padding
+     */
+    inline static unsigned ReadBits( const unsigned char *base, size_t pos, unsigned nbits ){
+        uint64_t w;
+        std::memcpy( &w, base + ( pos >> 3 ), sizeof(w) );
+        return static_cast<unsigned>( ( w >> ( pos & 7 ) ) & ( ( 1ULL << nbits ) - 1ULL ) );
     }
+   private:
+    // plain entries
+    const REntry *dptr_, *end_;
+    // compressed streams
+    const unsigned char *rows_, *runs_;
+    const bst_float *values_;
+    size_t row_pos_, run_pos_;
+    unsigned row_bits_, run_bits_;
+    bool delta_;
+    size_t left_;
+    unsigned run_left_;
+    // current entry
+    bst_uint rindex_;
+    bst_float fvalue_;
   };
  public:
   // the following are column meta data, should be able to answer them fast
@@ -73,6 +169,16 @@ struct IFMatrix {
   virtual bool HaveColAccess(void) const = 0;
   /*!  \brief get row iterator*/
   virtual RowIter GetRow(size_t ridx) const = 0;
+  /*!
+   * \brief get a row as dense array, for matrices that store rows densely,
+   *        so that callers can use a tight loop over the values
+   * \param ridx row index
+   * \param ncol output number of values in the row
+   * \return start of the row where NaN marks missing value, NULL if rows are not dense
+   */
+  virtual const bst_float *GetDenseRow(size_t ridx, size_t *ncol) const {
+    return NULL;
+  }
   /*!
    * \brief get column iterator, the columns must be sorted by feature value
    * \param ridx column index
@@ -81,6 +187,10 @@ struct IFMatrix {
   virtual ColIter GetSortedCol(size_t ridx) const = 0;
   /*! \return number of columns in the FMatrix */
   virtual size_t NumCol(void) const = 0;
+  /*! \return number of rows in the FMatrix */
+  virtual size_t NumRow(void) const = 0;
+  /*! \return number of nonzero entries in the FMatrix */
+  virtual size_t NumEntry(void) const = 0;
   // virtual destructor
   virtual ~IFMatrix(void) {}
 };
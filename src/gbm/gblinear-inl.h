@@ -44,6 +44,15 @@ class LinearBooster : public IGradBooster {
   }
   inline float Predict(const IFMatrix &fmat, bst_uint ridx, unsigned root_index) {
     float sum = model.bias();
+    size_t ncol;
+    const bst_float *row = fmat.GetDenseRow(ridx, &ncol);
+    if (row != NULL) {
+      const float *w = &model.weight[0];
+      for (size_t j = 0; j < ncol; ++j) {
+        if (row[j] == row[j]) sum += w[j] * row[j];
+      }
+      return sum;
+    }
     for (IFMatrix::RowIter it = fmat.GetRow(ridx); it.Next(); ) { 
       sum += model.weight[it.findex()] * it.fvalue();
     }
@@ -19,6 +19,15 @@
 namespace xgboost{
 /*! \brief namespace for gradient booster */
 namespace gbm {
+class RegTree;
+/*!
+ * \brief state kept across rounds by the boosters of a model, e.g. the quantized training matrix,
+ *        owned by the model and dropped when the training data changes
+ */
+class IBoosterCache {
+ public:
+  virtual ~IBoosterCache(void) {}
+};
 /*! 
 * \brief interface of a gradient boosting learner 
 * \tparam IFMatrix the feature matrix format that the booster takes
@@ -60,6 +69,12 @@ class IGradBooster {
                        std::vector<float> &hess,
                        const IFMatrix &feats,
                        const std::vector<unsigned> &root_index) = 0;
+  /*!
+   * \brief give the booster the cache slot of its model, called before DoBoost,
+   *        the booster may create its cache in the slot, the model deletes it
+   * \param slot the cache slot, shared by the boosters of the model
+   */
+  virtual void SetCache(IBoosterCache **slot) {}
   /*! 
    * \brief predict the path ids along a trees, for given sparse feature vector. When booster is a tree
    * \param path the result of path
@@ -98,6 +113,13 @@ class IGradBooster {
     utils::Error("not implemented");
     return 0.0f;
   }
+  /*!
+   * \brief get the tree of the booster, used to compile the ensemble for prediction
+   * \return the tree, NULL if the booster is not a tree
+   */
+  virtual const RegTree *GetTree(void) const {
+    return NULL;
+  }
   /*! 
    * \brief print information
    * \param fo output stream 
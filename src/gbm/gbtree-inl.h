@@ -3,6 +3,8 @@
 
 #include <cstring>
 #include "gbm.h"
+#include "tree_ensemble.h"
+#include "quickscorer.h"
 #include "../data.h"
 //#include "../utils/xgboost_omp.h"
 #include "../utils/config.h"
@@ -25,10 +27,12 @@ namespace gbm {
 class GBTree {
  public:
   /*! \brief number of thread used */
-  GBTree(void) {}
+  GBTree(void) : ensemble_dirty(true), ensemble_ok(false), pred_block(128), pred_simd(1), predictor(0),
+                 cache(NULL) {}
   /*! \brief destructor */
   virtual ~GBTree(void) {
     this->FreeSpace();
+    this->ClearCache();
   }
   /*! 
    * \brief set parameters from outside 
@@ -42,6 +46,13 @@ class GBTree {
     if (!strcmp(name, "silent")) {
       this->SetParam("bst:silent", val);
     }
+    if (!strcmp(name, "pred_block")) pred_block = atoi(val);
+    if (!strcmp(name, "pred_simd")) pred_simd = atoi(val);
+    if (!strcmp(name, "predictor")) {
+      if (!strcmp(val, "tree")) predictor = 0;
+      else if (!strcmp(val, "quickscorer")) predictor = 1;
+      else utils::Error("unknown predictor, can be tree or quickscorer");
+    }
     if (boosters.size() == 0) mparam.SetParam( name, val );
   }
   /*! 
@@ -77,6 +88,8 @@ class GBTree {
         utils::Assert( fi.Read( &pred_buffer[0] , pred_buffer.size()*sizeof(float) ) != 0 );
         utils::Assert( fi.Read( &pred_counter[0], pred_counter.size()*sizeof(unsigned) ) != 0 );
     }
+    ensemble_dirty = true;
+    this->Compile();
   }
   /*!
   * \brief initialize the current data storage for model, if the model is used first time, call this function
@@ -112,7 +125,85 @@ class GBTree {
                       const IFMatrix &feats,
                       const std::vector<unsigned> &root_index) {
     IGradBooster *bst = this->GetUpdateBooster();
+    bst->SetCache(&cache);
     bst->DoBoost(grad, hess, feats, root_index);
+    // a booster updated in place can not be appended to the ensemble
+    if (mparam.do_reboost != 0) ensemble_dirty = true;
+  }
+  /*! \brief drop the state the boosters keep across rounds, called when the training data changes */
+  inline void ClearCache(void) {
+    delete cache; cache = NULL;
+  }
+  /*!
+   * \brief compile the boosters into a flattened ensemble for prediction, only the boosters
+   *        added since the last call are compiled unless the ensemble is dirty,
+   *        does nothing when the boosters are not trees
+   */
+  inline void Compile(void) {
+    if (ensemble_dirty) {
+      ensemble.Clear(); quickscorer.Clear();
+      ensemble_ok = true; ensemble_dirty = false;
+    }
+    if (ensemble_ok && ensemble.NumTrees() != boosters.size()) {
+      ensemble_ok = ensemble.Append(boosters);
+    }
+  }
+  /*!
+   * \brief build the QuickScorer engine when the boosters have changed since it was built
+   * \return whether the engine is usable, false when some tree has more than 64 leaves
+   */
+  inline bool InitQuickScorer(void) {
+    if (quickscorer.NumTrees() == boosters.size()) return true;
+    if (!quickscorer.Init(boosters)) {
+      utils::Warning("QuickScorer needs trees with at most 64 leaves, use predictor=tree instead");
+      predictor = 0;
+      return false;
+    }
+    return true;
+  }
+  /*!
+   * \brief predict the margins of all the rows, rows are predicted in blocks by the compiled ensemble,
+   *        or row by row by the boosters when they are not trees; must be called out of parallel regions;
+   *        with predictor=quickscorer the rows without buffer are predicted by QuickScorer, the buffered
+   *        ones only need the newest trees, which the ensemble walks, so training stays linear in rounds
+   * \param feats feature matrix
+   * \param root_index root id of each row, empty means 0 for all
+   * \param buffer_offset buffer index of the first row, -1 means no buffer assigned
+   * \param out output margin of each row, its size gives the number of rows
+   */
+  inline void PredictBatch(const IFMatrix &feats,
+                           const std::vector<unsigned> &root_index,
+                           int buffer_offset,
+                           std::vector<float> *out) {
+    this->Compile();
+    const unsigned ndata = static_cast<unsigned>(out->size());
+    if (!ensemble_ok || pred_block <= 0) {
+      #pragma omp parallel for schedule(static)
+      for (unsigned j = 0; j < ndata; ++j) {
+        const unsigned rid = root_index.size() == 0 ? 0 : root_index[j];
+        (*out)[j] = this->Predict(feats, j, buffer_offset < 0 ? -1 : buffer_offset + static_cast<int>(j), rid);
+      }
+      return;
+    }
+    const bool use_buffer = mparam.do_reboost == 0 && buffer_offset >= 0;
+    std::vector<unsigned> tree_begin;
+    if (use_buffer) {
+      utils::Assert(buffer_offset + ndata <= pred_buffer.size(), "buffer index exceed num_pbuffer");
+      tree_begin.assign(pred_counter.begin() + buffer_offset, pred_counter.begin() + buffer_offset + ndata);
+      std::copy(pred_buffer.begin() + buffer_offset, pred_buffer.begin() + buffer_offset + ndata, out->begin());
+    } else {
+      std::fill(out->begin(), out->end(), 0.0f);
+    }
+    if (buffer_offset < 0 && predictor == 1 && this->InitQuickScorer()) {
+      quickscorer.PredictBatch(feats, root_index, out);
+    } else {
+      ensemble.PredictBatch(feats, root_index, tree_begin, static_cast<size_t>(pred_block), pred_simd, out);
+    }
+    if (use_buffer) {
+      std::fill(pred_counter.begin() + buffer_offset, pred_counter.begin() + buffer_offset + ndata,
+                static_cast<unsigned>(boosters.size()));
+      std::copy(out->begin(), out->end(), pred_buffer.begin() + buffer_offset);
+    }
   }
   /*! 
    * \brief predict values for given sparse feature vector
@@ -123,7 +214,7 @@ class GBTree {
    * \param root_index root id of current instance, default = 0
    * \return prediction 
    */
-  inline float Predict(const FMatrixS &feats, bst_uint row_index, int buffer_index = -1, unsigned root_index = 0) {
+  inline float Predict(const IFMatrix &feats, bst_uint row_index, int buffer_index = -1, unsigned root_index = 0) {
     size_t istart = 0;
     float psum = 0.0f;
 
@@ -221,6 +312,20 @@ class GBTree {
  protected:
   /*! \brief component boosters */ 
   std::vector<IGradBooster*> boosters;
+  /*! \brief compiled form of the boosters, for prediction */
+  TreeEnsemble ensemble;
+  /*! \brief QuickScorer form of the boosters, built only with predictor=quickscorer */
+  QuickScorer quickscorer;
+  /*! \brief whether the boosters changed since the ensemble is compiled */
+  bool ensemble_dirty;
+  /*! \brief whether the ensemble is usable, false when the boosters are not trees */
+  bool ensemble_ok;
+  /*! \brief number of rows predicted together by the ensemble, 0 means row by row by the boosters */
+  int pred_block;
+  /*! \brief kernel to walk the trees, 0: scalar, 1: widest vector kernel supported, 2: AVX2 at most */
+  int pred_simd;
+  /*! \brief prediction engine of the trees, 0: tree walk of the compiled ensemble, 1: QuickScorer */
+  int predictor;
   /*! \brief prediction buffer */ 
   std::vector<float> pred_buffer;
   /*! \brief prediction buffer counter, record the progress so fart of the buffer */ 
@@ -228,6 +333,8 @@ class GBTree {
   // ----training fields----
   // configurations for tree
   std::vector< std::pair<std::string, std::string> > cfg;
+  /*! \brief state kept across rounds by the boosters, built on the training data */
+  IBoosterCache *cache;
 };
 }  // namespace gbm
 }  // namespace xgboost
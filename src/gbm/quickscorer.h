@@ -0,0 +1,251 @@
+#ifndef XGBOOST_GBM_QUICKSCORER_H_
+#define XGBOOST_GBM_QUICKSCORER_H_
+/*!
+ * \file quickscorer.h
+ * \brief QuickScorer prediction of a tree ensemble, the trees are not walked node by node,
+ *        instead the split nodes of all the trees are sorted by feature and threshold,
+ *        a row visits the nodes of each feature whose test is false for it, i.e. the row goes right,
+ *        and clears the leaves of their left subtrees from a bitvector of the tree;
+ *        the leaves of a tree are numbered from left to right, the exit leaf is the lowest bit left
+ *
+ *        a tree takes one 64 bit word, so every tree must have at most 64 leaves;
+ *        each root of a tree with multiple roots is a tree of its own here
+ */
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <inttypes.h>
+#include "gbm.h"
+#include "../data.h"
+#include "../utils/omp.h"
+#include "../utils/utils.h"
+#include "../tree/tree_model.h"
+
+namespace xgboost {
+namespace gbm {
+/*! \brief QuickScorer engine, immutable once built */
+class QuickScorer {
+ public:
+  QuickScorer(void) {
+    this->Clear();
+  }
+  /*!
+   * \brief build from the boosters
+   * \param boosters boosters of the model
+   * \return whether the engine is built, false when some booster is not a tree or has more than 64 leaves
+   */
+  inline bool Init(const std::vector<IGradBooster*> &boosters) {
+    this->Clear();
+    for (size_t i = 0; i < boosters.size(); ++i) {
+      const RegTree *tree = boosters[i]->GetTree();
+      if (tree == NULL) return false;
+      for (int gid = 0; gid < tree->param.num_roots; ++gid) {
+        if (CountLeaf(*tree, gid) > 64) return false;
+      }
+    }
+    std::vector<Cond> conds;
+    tree_ptr.push_back(0);
+    for (size_t i = 0; i < boosters.size(); ++i) {
+      const RegTree &tree = *boosters[i]->GetTree();
+      for (int gid = 0; gid < tree.param.num_roots; ++gid) {
+        const unsigned qtree = tree_ptr.back() + gid;
+        unsigned nleaf = 0;
+        leaf_value.resize((qtree + 1) * 64, 0.0f);
+        this->AddNode(tree, gid, qtree, &nleaf, &conds);
+      }
+      tree_ptr.push_back(tree_ptr.back() + tree.param.num_roots);
+      min_roots = std::min(min_roots, static_cast<unsigned>(tree.param.num_roots));
+    }
+    // group the nodes by feature slot, in increasing order of threshold
+    std::sort(conds.begin(), conds.end(), CmpCond);
+    const size_t nslot = slot_fid.size();
+    cond_ptr.assign(nslot + 1, 0); miss_ptr.assign(nslot + 1, 0);
+    for (size_t i = 0; i < conds.size(); ++i) {
+      ++cond_ptr[conds[i].slot + 1];
+      if (!conds[i].default_left) ++miss_ptr[conds[i].slot + 1];
+    }
+    for (size_t s = 0; s < nslot; ++s) {
+      cond_ptr[s + 1] += cond_ptr[s];
+      miss_ptr[s + 1] += miss_ptr[s];
+    }
+    for (size_t i = 0; i < conds.size(); ++i) {
+      threshold.push_back(conds[i].threshold);
+      cond_mask.push_back(TreeMask(conds[i].qtree, conds[i].mask));
+      if (!conds[i].default_left) {
+        miss_mask.push_back(TreeMask(conds[i].qtree, conds[i].mask));
+      }
+    }
+    return true;
+  }
+  /*! \brief drop the engine */
+  inline void Clear(void) {
+    threshold.clear(); cond_mask.clear(); cond_ptr.clear();
+    miss_mask.clear(); miss_ptr.clear();
+    leaf_value.clear(); tree_ptr.clear();
+    fslot.clear(); slot_fid.clear();
+    min_roots = std::numeric_limits<unsigned>::max();
+  }
+  /*! \return number of trees */
+  inline size_t NumTrees(void) const {
+    return tree_ptr.size() == 0 ? 0 : tree_ptr.size() - 1;
+  }
+  /*!
+   * \brief add the outputs of the trees to the margins of the rows, OpenMP parallel over rows,
+   *        the outputs of the trees of a row are summed in the order of the trees, as the tree walk does;
+   *        every condition is applied to every row, so the engine is meant for the whole model,
+   *        incremental predictions of the newest trees are left to the tree walk
+   * \param fmat feature matrix
+   * \param root_index root of each row, empty means root 0 for all
+   * \param out margin of each row, the outputs of the trees are added to it
+   */
+  inline void PredictBatch(const IFMatrix &fmat,
+                           const std::vector<unsigned> &root_index,
+                           std::vector<float> *out) const {
+    const unsigned nrow = static_cast<unsigned>(out->size());
+    const size_t nslot = slot_fid.size();
+    const size_t ntree = this->NumTrees();
+    const size_t nqtree = ntree == 0 ? 0 : tree_ptr.back();
+    #pragma omp parallel
+    {
+      std::vector<float> feat(nslot, std::numeric_limits<float>::quiet_NaN());
+      std::vector<uint64_t> leafset(nqtree);
+      #pragma omp for schedule(static)
+      for (unsigned ridx = 0; ridx < nrow; ++ridx) {
+        const unsigned gid = root_index.size() == 0 ? 0 : root_index[ridx];
+        utils::Check(ntree == 0 || gid < min_roots, "group of row %u exceed bst:num_roots of the model", ridx);
+        this->FillRow(fmat, ridx, &feat[0]);
+        std::fill(leafset.begin(), leafset.end(), ~static_cast<uint64_t>(0));
+        for (size_t s = 0; s < nslot; ++s) {
+          const float fvalue = feat[s];
+          if (fvalue != fvalue) {
+            for (unsigned j = miss_ptr[s]; j < miss_ptr[s + 1]; ++j) {
+              leafset[miss_mask[j].qtree] &= miss_mask[j].mask;
+            }
+          } else {
+            // the test fvalue < threshold is false for the nodes with threshold <= fvalue
+            for (unsigned j = cond_ptr[s]; j < cond_ptr[s + 1] && threshold[j] <= fvalue; ++j) {
+              leafset[cond_mask[j].qtree] &= cond_mask[j].mask;
+            }
+          }
+          feat[s] = std::numeric_limits<float>::quiet_NaN();
+        }
+        float psum = 0.0f;
+        for (size_t t = 0; t < ntree; ++t) {
+          const unsigned qtree = tree_ptr[t] + gid;
+          psum += leaf_value[qtree * 64 + LowestBit(leafset[qtree])];
+        }
+        (*out)[ridx] += psum;
+      }
+    }
+  }
+
+ private:
+  /*! \brief mask of a split node and the tree it applies to, read together */
+  struct TreeMask {
+    uint64_t mask;
+    unsigned qtree;
+    TreeMask(void) {}
+    TreeMask(unsigned qtree, uint64_t mask) : mask(mask), qtree(qtree) {}
+  };
+  /*! \brief a split node */
+  struct Cond {
+    unsigned slot;
+    float threshold;
+    unsigned qtree;
+    uint64_t mask;
+    bool default_left;
+  };
+  inline static bool CmpCond(const Cond &a, const Cond &b) {
+    if (a.slot != b.slot) return a.slot < b.slot;
+    return a.threshold < b.threshold;
+  }
+  /*! \return index of the lowest set bit of x, x is not 0 */
+  inline static unsigned LowestBit(uint64_t x) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+    unsigned k = 0;
+    while ((x & 1) == 0) {
+      x >>= 1; ++k;
+    }
+    return k;
+#endif
+  }
+  /*! \return number of leaves of the subtree of nid */
+  inline static unsigned CountLeaf(const RegTree &tree, int nid) {
+    if (tree[nid].is_leaf()) return 1;
+    return CountLeaf(tree, tree[nid].cleft()) + CountLeaf(tree, tree[nid].cright());
+  }
+  /*! \brief slot of feature fid in a densified row, added when fid is first split on */
+  inline unsigned GetSlot(unsigned fid) {
+    if (fid >= fslot.size()) fslot.resize(fid + 1, -1);
+    if (fslot[fid] < 0) {
+      fslot[fid] = static_cast<int>(slot_fid.size());
+      slot_fid.push_back(fid);
+    }
+    return static_cast<unsigned>(fslot[fid]);
+  }
+  /*!
+   * \brief number the leaves of the subtree of nid from left to right starting at *nleaf,
+   *        and add the split nodes, the mask of a node clears the leaves of its left subtree
+   */
+  inline void AddNode(const RegTree &tree, int nid, unsigned qtree,
+                      unsigned *nleaf, std::vector<Cond> *conds) {
+    if (tree[nid].is_leaf()) {
+      leaf_value[qtree * 64 + *nleaf] = tree[nid].leaf_value();
+      ++*nleaf; return;
+    }
+    const unsigned lbegin = *nleaf;
+    this->AddNode(tree, tree[nid].cleft(), qtree, nleaf, conds);
+    const unsigned lend = *nleaf;
+    this->AddNode(tree, tree[nid].cright(), qtree, nleaf, conds);
+    Cond c;
+    c.slot = this->GetSlot(tree[nid].split_index());
+    c.threshold = tree[nid].split_cond();
+    c.qtree = qtree;
+    // the left subtree has less than 64 leaves, as the right one has at least one
+    c.mask = ~(((static_cast<uint64_t>(1) << (lend - lbegin)) - 1) << lbegin);
+    c.default_left = tree[nid].default_left();
+    conds->push_back(c);
+  }
+  /*! \brief write the features of row ridx used by the trees to their slots, dst is all NaN */
+  inline void FillRow(const IFMatrix &fmat, bst_uint ridx, float *dst) const {
+    size_t ncol;
+    const bst_float *row = fmat.GetDenseRow(ridx, &ncol);
+    if (row != NULL) {
+      for (size_t s = 0; s < slot_fid.size(); ++s) {
+        if (slot_fid[s] < ncol) dst[s] = row[slot_fid[s]];
+      }
+      return;
+    }
+    for (IFMatrix::RowIter it = fmat.GetRow(ridx); it.Next();) {
+      const unsigned fid = it.findex();
+      if (fid < fslot.size() && fslot[fid] >= 0) dst[fslot[fid]] = it.fvalue();
+    }
+  }
+
+ private:
+  /*! \brief threshold of the split nodes, grouped by feature slot, increasing in a slot */
+  std::vector<float> threshold;
+  /*! \brief mask of each split node, applied when the row goes right */
+  std::vector<TreeMask> cond_mask;
+  /*! \brief the split nodes of slot s are [cond_ptr[s], cond_ptr[s+1]) */
+  std::vector<unsigned> cond_ptr;
+  /*! \brief mask of the split nodes sending missing value right, grouped by slot */
+  std::vector<TreeMask> miss_mask;
+  /*! \brief the missing-right nodes of slot s are [miss_ptr[s], miss_ptr[s+1]) */
+  std::vector<unsigned> miss_ptr;
+  /*! \brief 64 leaf values of each tree, in the order of the leaves */
+  std::vector<float> leaf_value;
+  /*! \brief trees of the roots of booster t are [tree_ptr[t], tree_ptr[t+1]) */
+  std::vector<unsigned> tree_ptr;
+  /*! \brief smallest number of roots of the boosters */
+  unsigned min_roots;
+  /*! \brief slot of each feature in a densified row, -1 if the feature is never split on */
+  std::vector<int> fslot;
+  /*! \brief feature of each slot */
+  std::vector<unsigned> slot_fid;
+};
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_GBM_QUICKSCORER_H_
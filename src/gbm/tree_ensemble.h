@@ -0,0 +1,209 @@
+#ifndef XGBOOST_GBM_TREE_ENSEMBLE_H_
+#define XGBOOST_GBM_TREE_ENSEMBLE_H_
+/*!
+ * \file tree_ensemble.h
+ * \brief compiled form of an ensemble of regression trees, used for prediction only,
+ *        the split nodes of all the trees are packed into arrays of each field,
+ *        and the leaf values are kept in an array of their own; the rows are predicted
+ *        in blocks, tree by tree
+ *
+ *        a child is referred to by an int, a non-negative one is the index of a split node,
+ *        a negative one is ~index of a leaf; the nodes of a tree are laid out in preorder,
+ *        so the left child of a node is mostly its next node; the walk itself is done by
+ *        the kernels in tree_simd.h
+ */
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "gbm.h"
+#include "tree_simd.h"
+#include "../data.h"
+#include "../utils/omp.h"
+#include "../utils/utils.h"
+#include "../tree/tree_model.h"
+
+namespace xgboost {
+namespace gbm {
+/*! \brief flattened regression tree ensemble, the trees are only appended once compiled */
+class TreeEnsemble {
+ public:
+  TreeEnsemble(void) {
+    this->Clear();
+  }
+  /*! \brief drop the ensemble */
+  inline void Clear(void) {
+    sindex.clear(); split_cond.clear();
+    cleft.clear(); cright.clear(); leaf_value.clear();
+    root.clear(); tree_ptr.assign(1, 0);
+    fslot.clear(); slot_fid.clear();
+    min_roots = std::numeric_limits<unsigned>::max();
+  }
+  /*!
+   * \brief compile the boosters not in the ensemble yet, the first NumTrees() boosters
+   *        must be the ones compiled before
+   * \param boosters boosters of the model
+   * \return whether the boosters are compiled, false when some booster is not a tree
+   */
+  inline bool Append(const std::vector<IGradBooster*> &boosters) {
+    for (size_t i = this->NumTrees(); i < boosters.size(); ++i) {
+      if (boosters[i]->GetTree() == NULL) return false;
+    }
+    for (size_t i = this->NumTrees(); i < boosters.size(); ++i) {
+      const RegTree &tree = *boosters[i]->GetTree();
+      for (int gid = 0; gid < tree.param.num_roots; ++gid) {
+        root.push_back(this->AddNode(tree, gid));
+      }
+      tree_ptr.push_back(static_cast<unsigned>(root.size()));
+      min_roots = std::min(min_roots, static_cast<unsigned>(tree.param.num_roots));
+    }
+    return true;
+  }
+  /*! \return number of trees */
+  inline size_t NumTrees(void) const {
+    return tree_ptr.size() - 1;
+  }
+  /*!
+   * \brief add the outputs of the trees to the margins of the rows, the rows are processed in blocks,
+   *        a block is densified once, then each tree is walked for all the rows of the block before
+   *        the next tree, so the nodes of a tree stay in cache; OpenMP parallel over blocks
+   * \param fmat feature matrix
+   * \param root_index root of each row, empty means root 0 for all
+   * \param tree_begin first tree to be added for each row, empty means 0 for all
+   * \param block_size number of rows in a block
+   * \param simd kernel to walk the trees, see SelectGetLeaves
+   * \param out margin of each row, the outputs of the trees are added to it
+   */
+  inline void PredictBatch(const IFMatrix &fmat,
+                           const std::vector<unsigned> &root_index,
+                           const std::vector<unsigned> &tree_begin,
+                           size_t block_size, int simd,
+                           std::vector<float> *out) const {
+    utils::Assert(block_size != 0, "TreeEnsemble: block size must be positive");
+    const size_t nrow = out->size();
+    const size_t nslot = std::max(slot_fid.size(), static_cast<size_t>(1));
+    // the kernels address a block with 32 bit offsets
+    utils::Check(block_size * nslot < (1U << 31), "TreeEnsemble: pred_block too large for the features used");
+    const unsigned nblock = static_cast<unsigned>((nrow + block_size - 1) / block_size);
+    const FGetLeaves get_leaves = SelectGetLeaves(simd);
+    FlatTreeView view;
+    if (sindex.size() != 0) {
+      view.sindex = &sindex[0]; view.split_cond = &split_cond[0];
+      view.cleft = &cleft[0]; view.cright = &cright[0];
+    } else {
+      view.sindex = NULL; view.split_cond = NULL; view.cleft = NULL; view.cright = NULL;
+    }
+    #pragma omp parallel
+    {
+      std::vector<float> feat(block_size * nslot, std::numeric_limits<float>::quiet_NaN());
+      std::vector<float> psum(block_size);
+      std::vector<int> rroot(block_size), start(block_size), leaf(block_size);
+      std::vector<unsigned> rbegin(block_size);
+      #pragma omp for schedule(dynamic, 1)
+      for (unsigned b = 0; b < nblock; ++b) {
+        const size_t begin = b * block_size;
+        const size_t n = std::min(block_size, nrow - begin);
+        unsigned tmin = static_cast<unsigned>(this->NumTrees());
+        for (size_t r = 0; r < n; ++r) {
+          const bst_uint ridx = static_cast<bst_uint>(begin + r);
+          const unsigned gid = root_index.size() == 0 ? 0 : root_index[ridx];
+          utils::Check(this->NumTrees() == 0 || gid < min_roots,
+                       "group of row %u exceed bst:num_roots of the model", ridx);
+          rroot[r] = static_cast<int>(gid);
+          rbegin[r] = tree_begin.size() == 0 ? 0 : tree_begin[ridx];
+          tmin = std::min(tmin, rbegin[r]);
+          psum[r] = 0.0f;
+          this->FillRow(fmat, ridx, &feat[r * nslot]);
+        }
+        const size_t ntree = this->NumTrees();
+        for (size_t t = tmin; t < ntree; ++t) {
+          const int *troot = &root[tree_ptr[t]];
+          for (size_t r = 0; r < n; ++r) {
+            start[r] = troot[rroot[r]];
+          }
+          get_leaves(view, &feat[0], static_cast<int>(nslot), &start[0], n, &leaf[0]);
+          for (size_t r = 0; r < n; ++r) {
+            if (t >= rbegin[r]) psum[r] += leaf_value[~leaf[r]];
+          }
+        }
+        for (size_t r = 0; r < n; ++r) {
+          (*out)[begin + r] += psum[r];
+          std::fill(feat.begin() + r * nslot, feat.begin() + (r + 1) * nslot,
+                    std::numeric_limits<float>::quiet_NaN());
+        }
+      }
+    }
+  }
+
+ private:
+  /*! \brief slot of feature fid in the densified rows, added when fid is first split on */
+  inline unsigned GetSlot(unsigned fid) {
+    if (fid >= fslot.size()) fslot.resize(fid + 1, -1);
+    if (fslot[fid] < 0) {
+      fslot[fid] = static_cast<int>(slot_fid.size());
+      slot_fid.push_back(fid);
+    }
+    return static_cast<unsigned>(fslot[fid]);
+  }
+  /*! \brief add the subtree of node nid in preorder, return the reference to it */
+  inline int AddNode(const RegTree &tree, int nid) {
+    if (tree[nid].is_leaf()) {
+      leaf_value.push_back(tree[nid].leaf_value());
+      return ~static_cast<int>(leaf_value.size() - 1);
+    }
+    const int k = static_cast<int>(sindex.size());
+    unsigned sidx = this->GetSlot(tree[nid].split_index());
+    if (tree[nid].default_left()) sidx |= (1U << 31);
+    sindex.push_back(sidx);
+    split_cond.push_back(tree[nid].split_cond());
+    cleft.push_back(0); cright.push_back(0);
+    const int l = this->AddNode(tree, tree[nid].cleft());
+    cleft[k] = l;
+    const int r = this->AddNode(tree, tree[nid].cright());
+    cright[k] = r;
+    return k;
+  }
+  /*! \brief write the features of row ridx used by the trees to their slots, dst is all NaN */
+  inline void FillRow(const IFMatrix &fmat, bst_uint ridx, float *dst) const {
+    size_t ncol;
+    const bst_float *row = fmat.GetDenseRow(ridx, &ncol);
+    if (row != NULL) {
+      for (size_t s = 0; s < slot_fid.size(); ++s) {
+        if (slot_fid[s] < ncol) dst[s] = row[slot_fid[s]];
+      }
+      return;
+    }
+    for (IFMatrix::RowIter it = fmat.GetRow(ridx); it.Next();) {
+      const unsigned fid = it.findex();
+      if (fid < fslot.size() && fslot[fid] >= 0) dst[fslot[fid]] = it.fvalue();
+    }
+  }
+
+ private:
+  /*!
+   * \brief slot of the split feature of each split node, see fslot, the highest bit
+   *        tells whether missing value goes left, as in TreeModel::Node
+   */
+  std::vector<unsigned> sindex;
+  /*! \brief split threshold of each split node, value smaller than it goes left */
+  std::vector<float> split_cond;
+  /*! \brief reference to the left and right child of each split node */
+  std::vector<int> cleft, cright;
+  /*! \brief value of each leaf */
+  std::vector<float> leaf_value;
+  /*! \brief reference to each root, the roots of tree t are root[tree_ptr[t], tree_ptr[t+1]) */
+  std::vector<int> root;
+  /*! \brief start of the roots of each tree */
+  std::vector<unsigned> tree_ptr;
+  /*! \brief smallest number of roots of the trees */
+  unsigned min_roots;
+  /*!
+   * \brief slot of each feature in the densified rows, -1 if the feature is never split on,
+   *        only the features used by the trees are densified, which keeps a block small
+   */
+  std::vector<int> fslot;
+  /*! \brief feature of each slot */
+  std::vector<unsigned> slot_fid;
+};
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_GBM_TREE_ENSEMBLE_H_
@@ -0,0 +1,151 @@
+#ifndef XGBOOST_GBM_TREE_SIMD_H_
+#define XGBOOST_GBM_TREE_SIMD_H_
+/*!
+ * \file tree_simd.h
+ * \brief kernels that walk a block of densified rows through one flattened tree,
+ *        the vector kernels advance 8 (AVX2) or 16 (AVX-512) rows in lockstep and gather
+ *        the node fields and feature values of each lane; a lane that reaches a leaf stops
+ *        while the others go on. The kernel is chosen at runtime by the CPU, the vector
+ *        kernels are compiled with target attributes, so no extra compiler flag is needed
+ */
+#include <cstddef>
+#include "../utils/utils.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XGBOOST_TREE_SIMD 1
+#include <immintrin.h>
+#else
+#define XGBOOST_TREE_SIMD 0
+#endif
+
+namespace xgboost {
+namespace gbm {
+/*!
+ * \brief arrays of the flattened trees read by the kernels, a node reference k >= 0 is a split node,
+ *        a negative one is a leaf; the lower 31 bits of sindex[k] is the slot of the split feature
+ *        in a densified row, the highest bit tells whether missing value goes left
+ */
+struct FlatTreeView {
+  const unsigned *sindex;
+  const float *split_cond;
+  const int *cleft, *cright;
+};
+/*!
+ * \brief type of kernel that walks n rows from their start nodes to the leaves
+ * \param tree the flattened trees
+ * \param feat densified rows, row r starts at feat + r * nslot, NaN marks missing value
+ * \param nslot size of a densified row
+ * \param start start node of each row
+ * \param n number of rows
+ * \param out output leaf reference of each row
+ */
+typedef void (*FGetLeaves)(const FlatTreeView &tree, const float *feat, int nslot,
+                           const int *start, size_t n, int *out);
+
+/*! \brief scalar kernel, one row at a time */
+inline void GetLeavesScalar(const FlatTreeView &tree, const float *feat, int nslot,
+                            const int *start, size_t n, int *out) {
+  for (size_t r = 0; r < n; ++r) {
+    const float *row = feat + r * nslot;
+    int k = start[r];
+    while (k >= 0) {
+      const unsigned sindex = tree.sindex[k];
+      const float fvalue = row[sindex & ((1U << 31) - 1U)];
+      if (fvalue != fvalue) {
+        k = (sindex >> 31) != 0 ? tree.cleft[k] : tree.cright[k];
+      } else {
+        k = fvalue < tree.split_cond[k] ? tree.cleft[k] : tree.cright[k];
+      }
+    }
+    out[r] = k;
+  }
+}
+
+#if XGBOOST_TREE_SIMD
+/*! \brief AVX2 kernel, 8 rows in lockstep, the rows left over go to the scalar kernel */
+__attribute__((target("avx2")))
+inline void GetLeavesAVX2(const FlatTreeView &tree, const float *feat, int nslot,
+                          const int *start, size_t n, int *out) {
+  const __m256i vzero = _mm256_setzero_si256();
+  const __m256i vminus1 = _mm256_set1_epi32(-1);
+  const __m256i vslot = _mm256_set1_epi32(0x7fffffff);
+  // offset of the densified row of each lane
+  const __m256i vrow = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32(nslot));
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const float *base = feat + i * nslot;
+    __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(start + i));
+    __m256i active = _mm256_cmpgt_epi32(idx, vminus1);
+    while (!_mm256_testz_si256(active, active)) {
+      const __m256 mactive = _mm256_castsi256_ps(active);
+      const __m256i sindex = _mm256_mask_i32gather_epi32(vzero, reinterpret_cast<const int*>(tree.sindex),
+                                                         idx, active, 4);
+      const __m256i fidx = _mm256_add_epi32(vrow, _mm256_and_si256(sindex, vslot));
+      const __m256 fvalue = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, fidx, mactive, 4);
+      const __m256 cond = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), tree.split_cond, idx, mactive, 4);
+      const __m256i cleft = _mm256_mask_i32gather_epi32(vzero, tree.cleft, idx, active, 4);
+      const __m256i cright = _mm256_mask_i32gather_epi32(vzero, tree.cright, idx, active, 4);
+      // NaN compares false, it goes left only when the default direction is left
+      const __m256 miss = _mm256_cmp_ps(fvalue, fvalue, _CMP_UNORD_Q);
+      const __m256 dleft = _mm256_castsi256_ps(_mm256_srai_epi32(sindex, 31));
+      const __m256 goleft = _mm256_or_ps(_mm256_cmp_ps(fvalue, cond, _CMP_LT_OQ), _mm256_and_ps(miss, dleft));
+      const __m256 next = _mm256_blendv_ps(_mm256_castsi256_ps(cright), _mm256_castsi256_ps(cleft), goleft);
+      idx = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(idx), next, mactive));
+      active = _mm256_cmpgt_epi32(idx, vminus1);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), idx);
+  }
+  GetLeavesScalar(tree, feat + i * nslot, nslot, start + i, n - i, out + i);
+}
+/*! \brief AVX-512 kernel, 16 rows in lockstep, the rows left over go to the scalar kernel */
+__attribute__((target("avx512f")))
+inline void GetLeavesAVX512(const FlatTreeView &tree, const float *feat, int nslot,
+                            const int *start, size_t n, int *out) {
+  const __m512i vzero = _mm512_setzero_si512();
+  const __m512i vminus1 = _mm512_set1_epi32(-1);
+  const __m512i vslot = _mm512_set1_epi32(0x7fffffff);
+  const __m512i vrow = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                            8, 9, 10, 11, 12, 13, 14, 15),
+                                          _mm512_set1_epi32(nslot));
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const float *base = feat + i * nslot;
+    __m512i idx = _mm512_loadu_si512(start + i);
+    __mmask16 active = _mm512_cmpgt_epi32_mask(idx, vminus1);
+    while (active != 0) {
+      const __m512i sindex = _mm512_mask_i32gather_epi32(vzero, active, idx, tree.sindex, 4);
+      const __m512i fidx = _mm512_add_epi32(vrow, _mm512_and_si512(sindex, vslot));
+      const __m512 fvalue = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), active, fidx, base, 4);
+      const __m512 cond = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), active, idx, tree.split_cond, 4);
+      const __m512i cleft = _mm512_mask_i32gather_epi32(vzero, active, idx, tree.cleft, 4);
+      const __m512i cright = _mm512_mask_i32gather_epi32(vzero, active, idx, tree.cright, 4);
+      const __mmask16 miss = _mm512_cmp_ps_mask(fvalue, fvalue, _CMP_UNORD_Q);
+      const __mmask16 dleft = _mm512_cmplt_epi32_mask(sindex, vzero);
+      const __mmask16 goleft = _mm512_cmp_ps_mask(fvalue, cond, _CMP_LT_OQ) | (miss & dleft);
+      idx = _mm512_mask_mov_epi32(idx, active, _mm512_mask_blend_epi32(goleft, cright, cleft));
+      active = _mm512_cmpgt_epi32_mask(idx, vminus1);
+    }
+    _mm512_storeu_si512(out + i, idx);
+  }
+  GetLeavesScalar(tree, feat + i * nslot, nslot, start + i, n - i, out + i);
+}
+#endif
+
+/*!
+ * \brief choose the kernel
+ * \param simd 0 for the scalar kernel, 1 for the widest vector kernel the CPU supports,
+ *        2 for AVX2 at most
+ */
+inline FGetLeaves SelectGetLeaves(int simd) {
+  if (simd == 0) return GetLeavesScalar;
+#if XGBOOST_TREE_SIMD
+  __builtin_cpu_init();
+  if (simd == 1 && __builtin_cpu_supports("avx512f")) return GetLeavesAVX512;
+  if (__builtin_cpu_supports("avx2")) return GetLeavesAVX2;
+#endif
+  return GetLeavesScalar;
+}
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_GBM_TREE_SIMD_H_
@@ -0,0 +1,448 @@
+#ifndef XGBOOST_IO_BINARY_BUFFER_H_
+#define XGBOOST_IO_BINARY_BUFFER_H_
+/*!
+ * \file binary_buffer.h
+ * \brief versioned binary buffer format of DMatrix, designed to be memory mapped
+ *     Layout:
+ *        the first page holds BufferHeader, which contains a table of sections,
+ *        each section starts at a page aligned offset;
+ *        all integers have fixed width, row/column pointers are stored as uint64_t,
+ *        entries are stored as IFMatrix::REntry (uint32_t index, float value),
+ *        multi-byte values are in the byte order of the machine that wrote the file;
+ *     Compressed buffer:
+ *        when flag kCompressed is set, each section is cut into blocks that are compressed
+ *        independently, the section starts with BlockHeader and one BlockEntry per block,
+ *        so any block can be decompressed on its own, and all blocks are decompressed in parallel
+ */
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <cstring>
+#include <inttypes.h>
+#include "../data.h"
+#include "../utils/utils.h"
+#include "../utils/io.h"
+#include "../utils/mmap.h"
+#include "../utils/omp.h"
+#include "../utils/lz.h"
+
+namespace xgboost {
+namespace io {
+/*! \brief header of binary buffer, occupies the first page of the file */
+struct BufferHeader {
+  /*! \brief magic number identifying the format, reads "XGBBUF02" */
+  static const uint64_t kMagic = 0x3230465542424758ULL;
+  /*! \brief current version of the format */
+  static const uint32_t kVersion = 2;
+  /*! \brief alignment of sections */
+  static const uint64_t kPageSize = 4096;
+  /*! \brief maximum number of sections */
+  static const int kMaxSection = 32;
+  /*! \brief type of sections */
+  enum SectionType {
+    kRowPtr = 0,
+    kRowData = 1,
+    kColPtr = 2,
+    kColData = 3,
+    kLabel = 4,
+    kColMeta = 5,
+    kColRows = 6,
+    kColRuns = 7,
+    kColValues = 8
+  };
+  /*! \brief flags describing the content */
+  enum Flag {
+    kColAccess = 1,
+    kColCompressed = 2,
+    kCompressed = 4
+  };
+  /*! \brief magic number, must equal kMagic */
+  uint64_t magic;
+  /*! \brief version of the format */
+  uint32_t version;
+  /*! \brief bit flags of content */
+  uint32_t flags;
+  /*! \brief number of rows */
+  uint64_t num_row;
+  /*! \brief number of columns, 0 if column access is not stored */
+  uint64_t num_col;
+  /*! \brief number of nonzero entries */
+  uint64_t num_entry;
+  /*! \brief byte offset of each section, relative to the start of file */
+  uint64_t sec_offset[kMaxSection];
+  /*! \brief byte size of each section, 0 means the section is absent */
+  uint64_t sec_size[kMaxSection];
+  /*! \brief number of bytes of text source the buffer is built from, 0 if unknown */
+  uint64_t src_size;
+  /*! \brief fingerprint of the text source, see LibSVMParser::Fingerprint */
+  uint64_t src_hash;
+  /*! \brief constructor */
+  BufferHeader(void) {
+    std::memset(this, 0, sizeof(BufferHeader));
+    magic = kMagic; version = kVersion;
+  }
+};
+
+/*! \brief header of a compressed section */
+struct BlockHeader {
+  /*! \brief number of bytes before compression */
+  uint64_t raw_size;
+  /*! \brief number of bytes of each block before compression, except the last one */
+  uint32_t block_size;
+  /*! \brief number of blocks */
+  uint32_t num_block;
+  /*! \brief size of elements, bytes of elements are grouped by position before compression */
+  uint32_t typesize;
+  /*! \brief whether elements are uint64_t stored as difference to the previous one */
+  uint32_t delta;
+};
+/*! \brief location of a compressed block, relative to the start of section */
+struct BlockEntry {
+  /*! \brief byte offset of the block */
+  uint64_t offset;
+  /*! \brief compressed size, equals the raw size if the block is stored without compression */
+  uint64_t size;
+};
+/*! \brief transform and compression of blocks of binary buffer */
+struct BlockCodec {
+  /*! \brief default number of bytes in a block */
+  static const uint32_t kBlockSize = 1 << 20;
+  /*!
+   * \brief compress a block
+   * \param src content of the block
+   * \param n number of bytes, multiple of typesize
+   * \param typesize size of elements
+   * \param delta whether elements are uint64_t to be delta encoded
+   * \param tmp temp space
+   * \param out compressed block
+   */
+  inline static void Encode(const unsigned char *src, size_t n, unsigned typesize, bool delta,
+                            std::vector<unsigned char> *tmp, std::vector<unsigned char> *out) {
+    tmp->resize(n); out->clear();
+    if (n == 0) return;
+    const unsigned char *p = src;
+    if (delta) {
+      uint64_t last = 0;
+      for (size_t i = 0; i < n; i += sizeof(uint64_t)) {
+        uint64_t v; std::memcpy(&v, src + i, sizeof(v));
+        const uint64_t d = v - last; last = v;
+        std::memcpy(&(*tmp)[i], &d, sizeof(d));
+      }
+      p = &(*tmp)[0];
+    }
+    std::vector<unsigned char> shuffled;
+    if (typesize > 1) {
+      shuffled.resize(n);
+      const size_t nelem = n / typesize;
+      for (size_t i = 0; i < nelem; ++i) {
+        for (unsigned b = 0; b < typesize; ++b) shuffled[b * nelem + i] = p[i * typesize + b];
+      }
+      p = &shuffled[0];
+    }
+    utils::LZCompress(p, n, out);
+    if (out->size() >= n) out->assign(p, p + n);
+  }
+  /*!
+   * \brief decompress a block
+   * \param src compressed block
+   * \param csize compressed size
+   * \param n number of bytes after decompression
+   * \param typesize size of elements
+   * \param delta whether elements are delta encoded uint64_t
+   * \param dst output of n bytes
+   * \param tmp temp space
+   * \return whether the block is valid
+   */
+  inline static bool Decode(const unsigned char *src, size_t csize, size_t n,
+                            unsigned typesize, bool delta, unsigned char *dst,
+                            std::vector<unsigned char> *tmp) {
+    if (n == 0) return csize == 0;
+    tmp->resize(n);
+    unsigned char *p = typesize > 1 ? &(*tmp)[0] : dst;
+    if (csize == n) {
+      std::memcpy(p, src, n);
+    } else if (!utils::LZDecompress(src, csize, p, n)) {
+      return false;
+    }
+    if (typesize > 1) {
+      const size_t nelem = n / typesize;
+      for (size_t i = 0; i < nelem; ++i) {
+        for (unsigned b = 0; b < typesize; ++b) dst[i * typesize + b] = p[b * nelem + i];
+      }
+    }
+    if (delta) {
+      uint64_t last = 0;
+      for (size_t i = 0; i < n; i += sizeof(uint64_t)) {
+        uint64_t v; std::memcpy(&v, dst + i, sizeof(v));
+        last += v;
+        std::memcpy(dst + i, &last, sizeof(last));
+      }
+    }
+    return true;
+  }
+};
+
+/*! \brief writer of binary buffer, collects sections and writes them in one pass */
+class BufferWriter {
+ public:
+  /*! \brief constructor */
+  BufferWriter(void) : compress(false) {}
+  /*!
+   * \brief add a section, the memory must stay valid until Write is called
+   * \param type type of section
+   * \param dptr start of content
+   * \param nbytes number of bytes
+   * \param typesize size of elements, helps compression
+   * \param delta whether elements are increasing uint64_t, helps compression
+   */
+  inline void AddSection(int type, const void *dptr, size_t nbytes,
+                         unsigned typesize = 1, bool delta = false) {
+    utils::Assert(type >= 0 && type < BufferHeader::kMaxSection, "BufferWriter: invalid section");
+    if (nbytes % typesize != 0 || BlockCodec::kBlockSize % typesize != 0) typesize = 1;
+    header.sec_size[type] = nbytes;
+    secs_.push_back(Section(type, dptr, typesize, delta));
+  }
+  /*! \brief add a section of size_t pointers, stored as uint64_t */
+  inline void AddPtrSection(int type, const size_t *dptr, size_t n) {
+    if (sizeof(size_t) == sizeof(uint64_t)) {
+      this->AddSection(type, dptr, n * sizeof(uint64_t), sizeof(uint64_t), true);
+    } else {
+      temp_.push_back(std::vector<uint64_t>(dptr, dptr + n));
+      this->AddSection(type, n == 0 ? NULL : &temp_.back()[0], n * sizeof(uint64_t),
+                       sizeof(uint64_t), true);
+    }
+  }
+  /*!
+   * \brief write header and all sections to stream
+   * \param fo output stream
+   */
+  inline void Write(utils::IStream &fo) {
+    std::vector< std::vector<unsigned char> > packed;
+    if (compress) {
+      header.flags |= BufferHeader::kCompressed;
+      this->Compress(&packed);
+      for (size_t i = 0; i < secs_.size(); ++i) {
+        header.sec_size[secs_[i].type] = packed[i].size();
+        secs_[i].dptr = packed[i].size() == 0 ? NULL : &packed[i][0];
+      }
+    }
+    uint64_t offset = BufferHeader::kPageSize;
+    for (size_t i = 0; i < secs_.size(); ++i) {
+      header.sec_offset[secs_[i].type] = offset;
+      offset += Align(header.sec_size[secs_[i].type]);
+    }
+    std::vector<char> page(BufferHeader::kPageSize, 0);
+    std::memcpy(&page[0], &header, sizeof(BufferHeader));
+    fo.Write(&page[0], page.size());
+    std::fill(page.begin(), page.end(), 0);
+    for (size_t i = 0; i < secs_.size(); ++i) {
+      uint64_t nbytes = header.sec_size[secs_[i].type];
+      if (nbytes == 0) continue;
+      fo.Write(secs_[i].dptr, nbytes);
+      if (Align(nbytes) != nbytes) fo.Write(&page[0], Align(nbytes) - nbytes);
+    }
+  }
+  /*! \brief header to be written, fields other than section table are set by user */
+  BufferHeader header;
+  /*! \brief whether to compress the sections */
+  bool compress;
+
+ private:
+  struct Section {
+    int type;
+    const void *dptr;
+    unsigned typesize;
+    bool delta;
+    Section(int type, const void *dptr, unsigned typesize, bool delta)
+        : type(type), dptr(dptr), typesize(typesize), delta(delta) {}
+  };
+  /*! \brief compress all sections, blocks are compressed in parallel */
+  inline void Compress(std::vector< std::vector<unsigned char> > *packed) {
+    const uint32_t bsize = BlockCodec::kBlockSize;
+    std::vector< std::pair<size_t, size_t> > jobs;
+    for (size_t i = 0; i < secs_.size(); ++i) {
+      const uint64_t n = header.sec_size[secs_[i].type];
+      for (uint64_t b = 0; b * bsize < n; ++b) jobs.push_back(std::make_pair(i, b));
+    }
+    std::vector< std::vector<unsigned char> > blocks(jobs.size());
+    const int njob = static_cast<int>(jobs.size());
+    #pragma omp parallel
+    {
+      std::vector<unsigned char> tmp;
+      #pragma omp for schedule(dynamic, 1)
+      for (int j = 0; j < njob; ++j) {
+        const Section &sec = secs_[jobs[j].first];
+        const uint64_t n = header.sec_size[sec.type];
+        const uint64_t begin = jobs[j].second * bsize;
+        const uint64_t end = std::min(n, begin + bsize);
+        BlockCodec::Encode(static_cast<const unsigned char*>(sec.dptr) + begin,
+                           static_cast<size_t>(end - begin), sec.typesize, sec.delta,
+                           &tmp, &blocks[j]);
+      }
+    }
+    packed->resize(secs_.size());
+    size_t j = 0;
+    for (size_t i = 0; i < secs_.size(); ++i) {
+      BlockHeader bh;
+      bh.raw_size = header.sec_size[secs_[i].type];
+      bh.block_size = bsize;
+      bh.num_block = static_cast<uint32_t>((bh.raw_size + bsize - 1) / bsize);
+      bh.typesize = secs_[i].typesize;
+      bh.delta = secs_[i].delta ? 1 : 0;
+      if (bh.raw_size == 0) continue;
+      std::vector<BlockEntry> index(bh.num_block);
+      uint64_t offset = sizeof(BlockHeader) + sizeof(BlockEntry) * index.size();
+      for (uint32_t b = 0; b < bh.num_block; ++b) {
+        index[b].offset = offset;
+        index[b].size = blocks[j + b].size();
+        offset += index[b].size;
+      }
+      std::vector<unsigned char> &out = (*packed)[i];
+      out.resize(offset);
+      std::memcpy(&out[0], &bh, sizeof(bh));
+      std::memcpy(&out[sizeof(bh)], &index[0], sizeof(BlockEntry) * index.size());
+      for (uint32_t b = 0; b < bh.num_block; ++b, ++j) {
+        std::memcpy(&out[index[b].offset], &blocks[j][0], blocks[j].size());
+        std::vector<unsigned char>().swap(blocks[j]);
+      }
+    }
+  }
+  inline static uint64_t Align(uint64_t nbytes) {
+    return (nbytes + BufferHeader::kPageSize - 1) / BufferHeader::kPageSize * BufferHeader::kPageSize;
+  }
+  std::vector<Section> secs_;
+  std::list< std::vector<uint64_t> > temp_;
+};
+
+/*! \brief reader of binary buffer, the file is memory mapped and sections are served in place */
+class BufferReader {
+ public:
+  /*!
+   * \brief map the buffer file, and check the header
+   * \param fname name of the file
+   * \return false if the file can not be mapped, or is not in this format
+   */
+  inline bool Open(const char *fname) {
+    if (!mmap_.Open(fname)) return false;
+    if (mmap_.size() < BufferHeader::kPageSize ||
+        reinterpret_cast<const BufferHeader*>(mmap_.data())->magic != BufferHeader::kMagic) {
+      mmap_.Close(); return false;
+    }
+    const BufferHeader &h = this->header();
+    utils::Check(h.version == BufferHeader::kVersion,
+                 "binary buffer %s has version %u, expect %u", fname,
+                 (unsigned)h.version, (unsigned)BufferHeader::kVersion);
+    for (int i = 0; i < BufferHeader::kMaxSection; ++i) {
+      utils::Check(h.sec_size[i] == 0 || h.sec_offset[i] + h.sec_size[i] <= mmap_.size(),
+                   "binary buffer %s is truncated", fname);
+    }
+    if ((h.flags & BufferHeader::kCompressed) != 0) this->Decompress(fname);
+    return true;
+  }
+  /*! \brief release the mapping, all views obtained from it become invalid */
+  inline void Close(void) {
+    mmap_.Close();
+    for (int i = 0; i < BufferHeader::kMaxSection; ++i) {
+      std::vector<unsigned char>().swap(raw_[i]);
+    }
+  }
+  /*! \return number of blocks of a compressed section */
+  inline size_t NumBlock(int type) const {
+    if (!this->HasSection(type)) return 0;
+    return this->block_header(type).num_block;
+  }
+  /*!
+   * \brief decompress one block of a compressed section, gives random access to the file
+   * \param type type of section
+   * \param i index of block
+   * \param dst output, must hold the raw size of the block
+   * \param tmp temp space
+   * \return raw size of the block, 0 if the block is corrupted
+   */
+  inline size_t DecodeBlock(int type, size_t i, unsigned char *dst,
+                            std::vector<unsigned char> *tmp) const {
+    const BufferHeader &h = this->header();
+    const BlockHeader &bh = this->block_header(type);
+    const BlockEntry &e = reinterpret_cast<const BlockEntry*>(&bh + 1)[i];
+    const uint64_t begin = i * static_cast<uint64_t>(bh.block_size);
+    const uint64_t n = std::min(bh.raw_size - begin, static_cast<uint64_t>(bh.block_size));
+    if (e.offset > h.sec_size[type] || e.size > h.sec_size[type] - e.offset) return 0;
+    const unsigned char *src = reinterpret_cast<const unsigned char*>(&bh) + e.offset;
+    if (!BlockCodec::Decode(src, static_cast<size_t>(e.size), static_cast<size_t>(n),
+                            bh.typesize, bh.delta != 0, dst, tmp)) {
+      return 0;
+    }
+    return static_cast<size_t>(n);
+  }
+  /*! \return header of the buffer */
+  inline const BufferHeader &header(void) const {
+    return *reinterpret_cast<const BufferHeader*>(mmap_.data());
+  }
+  /*! \return whether a section is present */
+  inline bool HasSection(int type) const {
+    return this->header().sec_size[type] != 0;
+  }
+  /*!
+   * \brief get content of a section
+   * \param type type of section
+   * \param n output number of elements in the section
+   * \tparam T element type
+   */
+  template<typename T>
+  inline const T *Section(int type, size_t *n) const {
+    const BufferHeader &h = this->header();
+    if ((h.flags & BufferHeader::kCompressed) != 0) {
+      *n = raw_[type].size() / sizeof(T);
+      return raw_[type].size() == 0 ? NULL : reinterpret_cast<const T*>(&raw_[type][0]);
+    }
+    *n = static_cast<size_t>(h.sec_size[type] / sizeof(T));
+    if (h.sec_size[type] == 0) return NULL;
+    return reinterpret_cast<const T*>(mmap_.data() + h.sec_offset[type]);
+  }
+
+ private:
+  /*! \brief header of a compressed section */
+  inline const BlockHeader &block_header(int type) const {
+    return *reinterpret_cast<const BlockHeader*>(mmap_.data() + this->header().sec_offset[type]);
+  }
+  /*! \brief decompress all sections into memory, blocks are decompressed in parallel */
+  inline void Decompress(const char *fname) {
+    const BufferHeader &h = this->header();
+    std::vector< std::pair<int, size_t> > jobs;
+    for (int i = 0; i < BufferHeader::kMaxSection; ++i) {
+      if (h.sec_size[i] == 0) continue;
+      utils::Check(h.sec_size[i] >= sizeof(BlockHeader), "binary buffer %s is corrupted", fname);
+      const BlockHeader &bh = this->block_header(i);
+      utils::Check(bh.block_size != 0 &&
+                   bh.num_block == (bh.raw_size + bh.block_size - 1) / bh.block_size &&
+                   (h.sec_size[i] - sizeof(BlockHeader)) / sizeof(BlockEntry) >= bh.num_block &&
+                   bh.typesize != 0 && bh.block_size % bh.typesize == 0 &&
+                   bh.raw_size % bh.typesize == 0 &&
+                   (bh.delta == 0 || bh.typesize == sizeof(uint64_t)),
+                   "binary buffer %s is corrupted", fname);
+      raw_[i].resize(static_cast<size_t>(bh.raw_size));
+      for (size_t b = 0; b < bh.num_block; ++b) jobs.push_back(std::make_pair(i, b));
+    }
+    const int njob = static_cast<int>(jobs.size());
+    int nfail = 0;
+    #pragma omp parallel reduction(+:nfail)
+    {
+      std::vector<unsigned char> tmp;
+      #pragma omp for schedule(dynamic, 1)
+      for (int j = 0; j < njob; ++j) {
+        const int type = jobs[j].first;
+        const size_t b = jobs[j].second;
+        const size_t begin = b * this->block_header(type).block_size;
+        if (this->DecodeBlock(type, b, &raw_[type][begin], &tmp) == 0) ++nfail;
+      }
+    }
+    utils::Check(nfail == 0, "binary buffer %s is corrupted", fname);
+  }
+  /*! \brief the mapped file */
+  utils::MMapFile mmap_;
+  /*! \brief content of sections of compressed buffer */
+  std::vector<unsigned char> raw_[BufferHeader::kMaxSection];
+};
+}  // namespace io
+}  // namespace xgboost
+#endif  // XGBOOST_IO_BINARY_BUFFER_H_
@@ -0,0 +1,144 @@
+#ifndef XGBOOST_IO_DENSE_FMATRIX_INL_H_
+#define XGBOOST_IO_DENSE_FMATRIX_INL_H_
+/*!
+ * \file dense_fmatrix-inl.h
+ * \brief feature matrix for data with few missing values,
+ *        rows are stored as one contiguous row-major array of values with NaN as missing,
+ *        the sorted columns for column access are built on the side on first use
+ */
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "../data.h"
+#include "../utils/utils.h"
+#include "../utils/omp.h"
+#include "../utils/thread.h"
+#include "./simple_fmatrix-inl.h"
+
+namespace xgboost {
+namespace io {
+/*! \brief dense feature matrix */
+class FMatrixD : public IFMatrix {
+ public:
+  FMatrixD(void) : num_row_(0), num_col_(0), num_entry_(0), col_ready_(false) {}
+  /*!
+   * \brief build the dense matrix from the rows of a sparse matrix
+   * \param smat the sparse matrix
+   * \param ncol number of columns, must exceed every feature index in smat
+   */
+  inline void Init(const FMatrixS &smat, size_t ncol) {
+    this->Clear();
+    utils::Assert(ncol != 0, "FMatrixD: empty matrix");
+    num_row_ = smat.NumRow(); num_col_ = ncol; num_entry_ = smat.NumEntry();
+    const bst_omp_uint nrow = static_cast<bst_omp_uint>(num_row_);
+    values_.resize(num_row_ * num_col_);
+    #pragma omp parallel for schedule(static)
+    for (bst_omp_uint i = 0; i < nrow; ++i) {
+      bst_float *row = &values_[static_cast<size_t>(i) * num_col_];
+      std::fill(row, row + num_col_, std::numeric_limits<bst_float>::quiet_NaN());
+      for (RowIter it = smat.GetRow(i); it.Next(); ) {
+        row[it.findex()] = it.fvalue();
+      }
+    }
+  }
+  /*! \brief clear the storage */
+  inline void Clear(void) {
+    num_row_ = 0; num_col_ = 0; num_entry_ = 0; col_ready_ = false;
+    std::vector<bst_float>().swap(values_);
+    std::vector<size_t>().swap(col_ptr_);
+    std::vector<REntry>().swap(col_data_);
+  }
+
+ public:
+  virtual bool HaveColAccess(void) const {
+    return true;
+  }
+  virtual RowIter GetRow(size_t ridx) const {
+    return RowIter(&values_[0] + ridx * num_col_, num_col_);
+  }
+  virtual const bst_float *GetDenseRow(size_t ridx, size_t *ncol) const {
+    *ncol = num_col_;
+    return &values_[0] + ridx * num_col_;
+  }
+  virtual ColIter GetSortedCol(size_t cidx) const {
+    this->LazyInitCol();
+    return ColIter(&col_data_[0] + col_ptr_[cidx] - 1, &col_data_[0] + col_ptr_[cidx + 1] - 1);
+  }
+  virtual size_t NumCol(void) const {
+    return num_col_;
+  }
+  virtual size_t NumRow(void) const {
+    return num_row_;
+  }
+  virtual size_t NumEntry(void) const {
+    return num_entry_;
+  }
+
+ private:
+  typedef int bst_omp_uint;
+  // the lock can not be shared between copies
+  FMatrixD(const FMatrixD &other);
+  FMatrixD &operator=(const FMatrixD &other);
+  /*! \brief build the sorted columns on first use, safe to call from multiple threads */
+  inline void LazyInitCol(void) const {
+    // pairs with the release store at the end of InitColAccess
+    if (__atomic_load_n(&col_ready_, __ATOMIC_ACQUIRE)) return;
+    utils::LockGuard lock(col_mutex_);
+    if (col_ready_) return;
+    const_cast<FMatrixD*>(this)->InitColAccess();
+  }
+  /*! \brief gather the present values of each column, and sort them */
+  inline void InitColAccess(void) {
+    const bst_omp_uint ncol = static_cast<bst_omp_uint>(num_col_);
+    const size_t nrow = num_row_;
+    col_ptr_.resize(num_col_ + 1);
+    col_ptr_[0] = 0;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (bst_omp_uint j = 0; j < ncol; ++j) {
+      size_t cnt = 0;
+      for (size_t i = 0; i < nrow; ++i) {
+        const bst_float v = values_[i * num_col_ + j];
+        if (v == v) ++cnt;
+      }
+      col_ptr_[j + 1] = cnt;
+    }
+    for (bst_omp_uint j = 0; j < ncol; ++j) col_ptr_[j + 1] += col_ptr_[j];
+    col_data_.resize(col_ptr_.back());
+    #pragma omp parallel
+    {
+      std::vector<REntry> tmp;
+      #pragma omp for schedule(dynamic, 1)
+      for (bst_omp_uint j = 0; j < ncol; ++j) {
+        size_t k = col_ptr_[j];
+        for (size_t i = 0; i < nrow; ++i) {
+          const bst_float v = values_[i * num_col_ + j];
+          if (v == v) col_data_[k++] = REntry(static_cast<bst_uint>(i), v);
+        }
+        if (col_ptr_[j + 1] - col_ptr_[j] > 1) {
+          FMatrixS::SortByValue(&col_data_[0] + col_ptr_[j], &col_data_[0] + col_ptr_[j + 1], &tmp);
+        }
+      }
+    }
+    // publish the columns before the flag, see LazyInitCol
+    __atomic_store_n(&col_ready_, true, __ATOMIC_RELEASE);
+  }
+  /*! \brief number of rows */
+  size_t num_row_;
+  /*! \brief number of columns */
+  size_t num_col_;
+  /*! \brief number of present values */
+  size_t num_entry_;
+  /*! \brief row-major values, NaN marks missing value */
+  std::vector<bst_float> values_;
+  /*! \brief column pointer of sorted columns */
+  std::vector<size_t> col_ptr_;
+  /*! \brief sorted columns */
+  std::vector<REntry> col_data_;
+  /*! \brief whether the sorted columns are built, read without the lock by atomic acquire */
+  bool col_ready_;
+  /*! \brief lock of building sorted columns on demand */
+  mutable utils::Mutex col_mutex_;
+};
+}  // namespace io
+}  // namespace xgboost
+#endif  // XGBOOST_IO_DENSE_FMATRIX_INL_H_
@@ -0,0 +1,379 @@
+#ifndef XGBOOST_IO_LIBSVM_PARSER_H_
+#define XGBOOST_IO_LIBSVM_PARSER_H_
+/*!
+ * \file libsvm_parser.h
+ * \brief multi-threaded parser of text data in LibSVM format
+ *     Format: each line contains one instance
+ *        label [feature index:feature value]+
+ *     the file is read in large blocks, each block is cut at line boundaries
+ *     into one chunk per thread, and the chunks are parsed in parallel;
+ *     the input can be a comma separated list of files or glob patterns,
+ *     e.g. shards of one dataset, which are read one after another as one stream
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <inttypes.h>
+#ifndef _MSC_VER
+#include <glob.h>
+#include <sys/types.h>
+#endif
+#include "../data.h"
+#include "../utils/utils.h"
+#include "../utils/omp.h"
+#include "./simple_fmatrix-inl.h"
+
+namespace xgboost {
+namespace io {
+/*! \brief parser of LibSVM text data */
+class LibSVMParser {
+ public:
+  /*!
+   * \brief constructor
+   * \param uri input files, a comma separated list of file names or glob patterns
+   * \param block_size number of bytes read from the file in each call of Next
+   * \param offset number of bytes to skip at the start of the input, must be at a line boundary
+   */
+  explicit LibSVMParser(const char *uri, size_t block_size = 64UL << 20, size_t offset = 0)
+      : fp_(NULL), file_index_(0), block_size_(block_size), carry_(0), bytes_read_(0),
+        skip_(offset) {
+    nthread_ = omp_get_max_threads();
+    ListFiles(uri, &files_);
+  }
+  ~LibSVMParser(void) {
+    if (fp_ != NULL) std::fclose(fp_);
+  }
+  /*!
+   * \brief read and parse next block of the input, a block never spans two files
+   * \return false if we reach the end of the last file
+   */
+  inline bool Next(void) {
+    while (fp_ == NULL) {
+      if (file_index_ == files_.size()) return false;
+      fp_ = utils::FopenCheck(files_[file_index_++].c_str(), "r");
+      if (skip_ != 0) {
+        // skip whole files before the offset, and seek into the file containing it
+        const size_t fsize = FileSize(fp_);
+        if (fsize <= skip_) {
+          skip_ -= fsize; std::fclose(fp_); fp_ = NULL;
+        } else {
+          utils::Check(fseeko(fp_, static_cast<off_t>(skip_), SEEK_SET) == 0,
+                       "LibSVMParser: fail to seek");
+          skip_ = 0;
+        }
+      }
+    }
+    if (buffer_.size() < block_size_) buffer_.resize(block_size_);
+    size_t nread = std::fread(&buffer_[carry_], 1, buffer_.size() - carry_, fp_);
+    bytes_read_ += nread;
+    size_t size = carry_ + nread;
+    const bool eof = nread != buffer_.size() - carry_;
+    if (eof) {
+      std::fclose(fp_); fp_ = NULL;
+    }
+    if (size == 0) return this->Next();
+    const char *head = &buffer_[0];
+    size_t end = size;
+    if (!eof) {
+      // buffer is full, cut at the last line boundary
+      while (end != 0 && !IsNewline(head[end - 1])) --end;
+      if (end == 0) {
+        // a single line is longer than the buffer, grow it and read more
+        carry_ = size;
+        buffer_.resize(buffer_.size() * 2);
+        return this->Next();
+      }
+    }
+    this->ParseBlock(head, head + end);
+    // a full buffer can end right at a line boundary, then there is nothing to carry and
+    // buffer_[end] is past the end
+    if (end != size) std::memmove(&buffer_[0], &buffer_[end], size - end);
+    carry_ = size - end;
+    return true;
+  }
+  /*! \return rows parsed by each thread in the last call of Next, in the order of the file */
+  inline const std::vector<RowBlock> &Blocks(void) const {
+    return blocks_;
+  }
+  /*! \return total number of bytes read from the files so far */
+  inline size_t BytesRead(void) const {
+    return bytes_read_;
+  }
+  /*! \return the files to be read */
+  inline const std::vector<std::string> &Files(void) const {
+    return files_;
+  }
+  /*!
+   * \brief fingerprint of the first nbytes of the input, used to check that the input
+   *        only grew since then; covers the size, the head and the tail of the range
+   * \param files input files, the content is their concatenation
+   * \param nbytes number of bytes covered, must not exceed the total size
+   */
+  inline static uint64_t Fingerprint(const std::vector<std::string> &files, size_t nbytes) {
+    const size_t kWindow = 64UL << 10;
+    std::string head, tail;
+    ReadRange(files, 0, std::min(nbytes, kWindow), &head);
+    ReadRange(files, nbytes - std::min(nbytes, kWindow), nbytes, &tail);
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL ^ static_cast<uint64_t>(nbytes);
+    const std::string *parts[2] = {&head, &tail};
+    for (int k = 0; k < 2; ++k) {
+      for (size_t i = 0; i < parts[k]->length(); ++i) {
+        h = (h ^ static_cast<unsigned char>((*parts[k])[i])) * 1099511628211ULL;
+      }
+    }
+    return h;
+  }
+  /*! \return total number of bytes of the files */
+  inline static size_t TotalSize(const std::vector<std::string> &files) {
+    size_t total = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+      std::FILE *fp = utils::FopenCheck(files[i].c_str(), "rb");
+      total += FileSize(fp);
+      std::fclose(fp);
+    }
+    return total;
+  }
+  /*!
+   * \brief read bytes [begin, end) of the concatenation of files
+   * \param files input files
+   * \param begin start of range
+   * \param end end of range
+   * \param out output content
+   */
+  inline static void ReadRange(const std::vector<std::string> &files,
+                               size_t begin, size_t end, std::string *out) {
+    out->resize(end - begin);
+    size_t base = 0, pos = begin;
+    for (size_t i = 0; i < files.size() && pos < end; ++i) {
+      std::FILE *fp = utils::FopenCheck(files[i].c_str(), "rb");
+      const size_t fsize = FileSize(fp);
+      if (pos < base + fsize) {
+        utils::Check(fseeko(fp, static_cast<off_t>(pos - base), SEEK_SET) == 0,
+                     "LibSVMParser: fail to seek");
+        const size_t n = std::min(end, base + fsize) - pos;
+        utils::Check(std::fread(&(*out)[pos - begin], 1, n, fp) == n, "LibSVMParser: fail to read");
+        pos += n;
+      }
+      base += fsize;
+      std::fclose(fp);
+    }
+    utils::Check(pos == end, "LibSVMParser: range exceeds input");
+  }
+  /*!
+   * \brief expand a comma separated list of file names or glob patterns,
+   *        files matching one pattern are sorted by name, patterns that match
+   *        nothing are kept as they are, so that opening them reports the error
+   * \param uri the list
+   * \param out output file names
+   */
+  inline static void ListFiles(const char *uri, std::vector<std::string> *out) {
+    out->clear();
+    const char *p = uri;
+    while (true) {
+      const char *q = std::strchr(p, ',');
+      std::string name = q == NULL ? std::string(p) : std::string(p, q - p);
+      if (name.length() != 0) {
+#ifndef _MSC_VER
+        glob_t g;
+        if (glob(name.c_str(), 0, NULL, &g) == 0) {
+          for (size_t i = 0; i < g.gl_pathc; ++i) out->push_back(g.gl_pathv[i]);
+        } else {
+          out->push_back(name);
+        }
+        globfree(&g);
+#else
+        out->push_back(name);
+#endif
+      }
+      if (q == NULL) break;
+      p = q + 1;
+    }
+  }
+  /*!
+   * \brief parse the lines in [begin, end) and append them to out
+   * \param begin start of the chunk, must be the start of a line
+   * \param end end of the chunk
+   * \param out the output row block
+   */
+  inline static void ParseChunk(const char *begin, const char *end, RowBlock *out) {
+    const char *p = begin;
+    while (p != end) {
+      while (p != end && IsBlank(*p)) ++p;
+      if (p == end) break;
+      const char *lend = p;
+      while (lend != end && !IsNewline(*lend)) ++lend;
+      if (*p == '#') {
+        p = lend; continue;
+      }
+      bst_float label;
+      const char *q = ParseFloat(p, lend, &label);
+      utils::Assert(q != p && (q == lend || IsBlank(*q)), "invalid format");
+      out->label.push_back(label);
+      p = q;
+      while (true) {
+        while (p != lend && IsBlank(*p)) ++p;
+        if (p == lend || *p == '#') break;
+        unsigned findex; bst_float fvalue;
+        q = ParseUInt(p, lend, &findex);
+        utils::Assert(q != p && q != lend && *q == ':', "invalid format");
+        p = q + 1;
+        q = ParseFloat(p, lend, &fvalue);
+        utils::Assert(q != p && (q == lend || IsBlank(*q)), "invalid format");
+        out->data.push_back(IFMatrix::REntry(findex, fvalue));
+        p = q;
+      }
+      out->offset.push_back(out->data.size());
+      p = lend;
+    }
+  }
+
+ private:
+  /*! \return size of an open file */
+  inline static size_t FileSize(std::FILE *fp) {
+    const off_t pos = ftello(fp);
+    utils::Check(fseeko(fp, 0, SEEK_END) == 0, "LibSVMParser: fail to seek");
+    const off_t size = ftello(fp);
+    utils::Check(fseeko(fp, pos, SEEK_SET) == 0, "LibSVMParser: fail to seek");
+    return static_cast<size_t>(size);
+  }
+  // the open file can not be shared between copies
+  LibSVMParser(const LibSVMParser &other);
+  LibSVMParser &operator=(const LibSVMParser &other);
+  /*! \brief cut [begin, end) into one chunk per thread at line boundaries and parse them */
+  inline void ParseBlock(const char *begin, const char *end) {
+    const int nthread = nthread_;
+    std::vector<const char*> bound(nthread + 1);
+    bound[0] = begin; bound[nthread] = end;
+    const size_t len = end - begin;
+    for (int i = 1; i < nthread; ++i) {
+      const char *p = begin + len / nthread * i;
+      if (p < bound[i - 1]) p = bound[i - 1];
+      while (p != end && !IsNewline(*p)) ++p;
+      bound[i] = p;
+    }
+    blocks_.resize(nthread);
+    #pragma omp parallel for schedule(static, 1) num_threads(nthread)
+    for (int i = 0; i < nthread; ++i) {
+      blocks_[i].Clear();
+      ParseChunk(bound[i], bound[i + 1], &blocks_[i]);
+    }
+  }
+  inline static bool IsNewline(char c) {
+    return c == '\n' || c == '\r';
+  }
+  inline static bool IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+  inline static bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+  }
+  /*! \brief parse unsigned integer, return the position after it, or p on failure */
+  inline static const char *ParseUInt(const char *p, const char *end, unsigned *out) {
+    unsigned v = 0;
+    while (p != end && IsDigit(*p)) {
+      v = v * 10 + static_cast<unsigned>(*p - '0'); ++p;
+    }
+    *out = v;
+    return p;
+  }
+  /*!
+   * \brief parse floating point number, return the position after it, or p on failure
+   *  the common case of plain decimals is handled by hand, other forms fall back to strtod
+   */
+  inline static const char *ParseFloat(const char *p, const char *end, bst_float *out) {
+    static const double kPow10[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *s = p;
+    bool neg = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+      neg = *p == '-'; ++p;
+    }
+    uint64_t mant = 0;
+    int exp10 = 0, ndigit = 0;
+    while (p != end && IsDigit(*p)) {
+      if (mant < 100000000000000000ULL) {
+        mant = mant * 10 + static_cast<unsigned>(*p - '0');
+      } else {
+        ++exp10;
+      }
+      ++p; ++ndigit;
+    }
+    if (p != end && *p == '.') {
+      ++p;
+      while (p != end && IsDigit(*p)) {
+        if (mant < 100000000000000000ULL) {
+          mant = mant * 10 + static_cast<unsigned>(*p - '0'); --exp10;
+        }
+        ++p; ++ndigit;
+      }
+    }
+    if (ndigit == 0) return ParseFloatSlow(s, end, out);
+    if (p != end && (*p == 'e' || *p == 'E')) {
+      const char *q = p + 1;
+      bool eneg = false;
+      if (q != end && (*q == '-' || *q == '+')) {
+        eneg = *q == '-'; ++q;
+      }
+      if (q == end || !IsDigit(*q)) return ParseFloatSlow(s, end, out);
+      int e = 0;
+      while (q != end && IsDigit(*q)) {
+        if (e < 10000) e = e * 10 + (*q - '0');
+        ++q;
+      }
+      exp10 += eneg ? -e : e;
+      p = q;
+    }
+    // exact in double when the mantissa has at most 53 bits and the power of ten is exact
+    if (mant >= (1ULL << 53) || exp10 < -22 || exp10 > 22) {
+      return ParseFloatSlow(s, end, out);
+    }
+    double v = static_cast<double>(mant);
+    v = exp10 < 0 ? v / kPow10[-exp10] : v * kPow10[exp10];
+    *out = static_cast<bst_float>(neg ? -v : v);
+    return p;
+  }
+  /*! \brief slow path of ParseFloat, handles everything strtod understands */
+  inline static const char *ParseFloatSlow(const char *p, const char *end, bst_float *out) {
+    char buf[64];
+    size_t len = 0;
+    while (p + len != end && len + 1 < sizeof(buf) && !IsBlank(p[len])) {
+      buf[len] = p[len]; ++len;
+    }
+    buf[len] = '\0';
+    char *endptr;
+    double v = std::strtod(buf, &endptr);
+    *out = static_cast<bst_float>(v);
+    return p + (endptr - buf);
+  }
+
+ private:
+  /*! \brief input files */
+  std::vector<std::string> files_;
+  /*! \brief file being read, NULL if no file is open */
+  std::FILE *fp_;
+  /*! \brief index of next file to open */
+  size_t file_index_;
+  /*! \brief number of threads used in parsing */
+  int nthread_;
+  /*! \brief number of bytes read in each block */
+  size_t block_size_;
+  /*! \brief number of bytes of unfinished line kept at the head of buffer */
+  size_t carry_;
+  /*! \brief total number of bytes read */
+  size_t bytes_read_;
+  /*! \brief number of bytes still to be skipped at the start of input */
+  size_t skip_;
+  /*! \brief read buffer */
+  std::vector<char> buffer_;
+  /*! \brief output of each thread */
+  std::vector<RowBlock> blocks_;
+};
+}  // namespace io
+}  // namespace xgboost
+#endif  // XGBOOST_IO_LIBSVM_PARSER_H_
@@ -0,0 +1,575 @@
+#ifndef XGBOOST_IO_PAGE_FMATRIX_INL_H_
+#define XGBOOST_IO_PAGE_FMATRIX_INL_H_
+/*!
+ * \file page_fmatrix-inl.h
+ * \brief external memory feature matrix, row data and sorted column data are
+ *        stored as pages in a cache file on local disk, only a bounded number
+ *        of pages are resident in memory at any time
+ *
+ *     Cache file layout:
+ *        [header page][row pages][column pages][page table][labels]
+ *        each page holds a contiguous range of rows (columns) in CSR (CSC) format:
+ *        uint64_t offset[n + 1], followed by REntry data[offset[n]]
+ */
+#include <vector>
+#include <list>
+#include <deque>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <inttypes.h>
+#include "../data.h"
+#include "../utils/utils.h"
+#include "../utils/omp.h"
+#include "../utils/thread.h"
+#include "./simple_fmatrix-inl.h"
+#include "./libsvm_parser.h"
+#ifndef _MSC_VER
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+#endif
+
+namespace xgboost {
+namespace io {
+/*!
+ * \brief disk backed feature matrix;
+ *    resident pages are kept in a LRU cache bounded by Param::cache_size, pages being read and
+ *    pinned pages count against it, the pages are built small enough that the pinned ones fit,
+ *    a background thread reads the pages following the ones in use ahead of the consumers.
+ *    Iterators point into resident pages: an iterator stays valid until the thread
+ *    that obtained it has obtained iterators from kPinPerThread other pages.
+ */
+class FMatrixPage : public IFMatrix {
+ public:
+  /*! \brief parameters of paged matrix */
+  struct Param {
+    /*!
+     * \brief target number of bytes of each page, clamped when building so that
+     *        the pages pinned by all the threads fit in cache_size, see BuildPageSize
+     */
+    size_t page_size;
+    /*! \brief maximum number of bytes of resident pages, also bounds the memory used when building */
+    size_t cache_size;
+    /*! \brief number of pages read ahead of the consumer */
+    int prefetch;
+    /*!
+     * \brief number of threads that read the matrix, 0 means omp_get_max_threads() of the opening thread,
+     *        set it when the matrix is opened outside the thread that reads it
+     */
+    int nthread;
+    /*! \brief constructor */
+    Param(void) {
+      page_size = 32UL << 20;
+      cache_size = 256UL << 20;
+      prefetch = 2;
+      nthread = 0;
+    }
+    /*!
+     * \brief set parameters from outside
+     * \param name name of the parameter
+     * \param val  value of the parameter
+     */
+    inline void SetParam(const char *name, const char *val) {
+      if (!strcmp("page_size_mb", name)) page_size = static_cast<size_t>(atof(val) * (1 << 20));
+      if (!strcmp("page_cache_mb", name)) cache_size = static_cast<size_t>(atof(val) * (1 << 20));
+      if (!strcmp("page_prefetch", name)) prefetch = atoi(val);
+      if (!strcmp("nthread", name)) nthread = atoi(val);
+    }
+    /*! \return number of threads that read the matrix */
+    inline int NumThread(void) const {
+      return nthread > 0 ? nthread : omp_get_max_threads();
+    }
+    /*! \return page size used to build, each of the threads pins up to kPinPerThread pages */
+    inline size_t BuildPageSize(void) const {
+      const size_t npin = static_cast<size_t>(this->NumThread()) * kPinPerThread;
+      return std::max(std::min(page_size, cache_size / npin), static_cast<size_t>(64UL << 10));
+    }
+  };
+  /*! \brief number of pages each thread keeps pinned */
+  static const int kPinPerThread = 4;
+
+ public:
+  FMatrixPage(void) : fd_(-1), stop_(false), resident_(0) {}
+  virtual ~FMatrixPage(void) {
+    this->Close();
+  }
+  /*!
+   * \brief open an existing cache file
+   * \param fname name of the cache file
+   * \param param parameters
+   * \param labels output labels of the rows
+   * \return false if the file does not exist or is not a page cache
+   */
+  inline bool Open(const char *fname, const Param &param, std::vector<float> *labels) {
+    this->Close();
+#ifdef _MSC_VER
+    utils::Error("external memory is not supported on this platform");
+#else
+    fd_ = open(fname, O_RDONLY);
+    if (fd_ < 0) return false;
+    if (pread(fd_, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_)) ||
+        header_.magic != Header::kMagic) {
+      close(fd_); fd_ = -1; return false;
+    }
+#endif
+    param_ = param;
+    std::vector<PageInfo> table(header_.num_row_page + header_.num_col_page);
+    ReadAt(fd_, table.size() == 0 ? NULL : &table[0], table.size() * sizeof(PageInfo), header_.table_offset);
+    labels->resize(header_.num_row);
+    ReadAt(fd_, labels->size() == 0 ? NULL : &(*labels)[0], labels->size() * sizeof(float), header_.label_offset);
+    for (int k = 0; k < 2; ++k) {
+      const size_t start = k == kRow ? 0 : header_.num_row_page;
+      const size_t npage = k == kRow ? header_.num_row_page : header_.num_col_page;
+      pages_[k].resize(npage);
+      page_begin_[k].resize(npage);
+      for (size_t i = 0; i < npage; ++i) {
+        pages_[k][i].info = table[start + i];
+        page_begin_[k][i] = table[start + i].begin;
+      }
+    }
+    slots_.clear();
+    slots_.resize(param.NumThread());
+    uint64_t max_page = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+      max_page = std::max(max_page, table[i].nbytes);
+    }
+    if (max_page * slots_.size() * kPinPerThread > param.cache_size) {
+      utils::Warning("FMatrixPage: pages pinned by the threads can exceed page_cache_mb, "
+                     "delete the cache file to rebuild it with smaller pages");
+    }
+    stop_ = false;
+    prefetcher_.Start(PrefetchEntry, this);
+    return true;
+  }
+  /*! \brief stop the prefetcher, release all pages and close the file */
+  inline void Close(void) {
+    if (fd_ < 0) return;
+    mutex_.Lock();
+    stop_ = true;
+    wakeup_.Signal();
+    mutex_.Unlock();
+    prefetcher_.Join();
+#ifndef _MSC_VER
+    close(fd_);
+#endif
+    fd_ = -1;
+    for (int k = 0; k < 2; ++k) {
+      pages_[k].clear(); page_begin_[k].clear();
+    }
+    lru_.clear(); queue_.clear(); slots_.clear();
+    resident_ = 0;
+  }
+  /*!
+   * \brief build cache file from LibSVM text data,
+   *        memory used is bounded by the parser block and param.cache_size
+   * \param text name of text data, a comma separated list of files or glob patterns
+   * \param fname name of the cache file to create
+   * \param param parameters
+   * \param silent whether print information or not
+   */
+  inline static void Build(const char *text, const char *fname, const Param &param, bool silent) {
+    FILE *fo = utils::FopenCheck(fname, "w+b");
+    Header header;
+    std::vector<PageInfo> table;
+    std::vector<float> labels;
+    std::vector<size_t> col_count;
+    // write placeholder of header
+    std::vector<char> zero(Header::kHeaderSize, 0);
+    utils::Assert(std::fwrite(&zero[0], zero.size(), 1, fo) != 0, "FMatrixPage: fail to write");
+    uint64_t offset = Header::kHeaderSize;
+    const size_t page_size = param.BuildPageSize();
+    {// pass over text, write row pages
+      LibSVMParser parser(text);
+      std::vector<uint64_t> ptr(1, 0);
+      std::vector<REntry> data;
+      uint64_t row_begin = 0;
+      while (parser.Next()) {
+        const std::vector<RowBlock> &blocks = parser.Blocks();
+        for (size_t b = 0; b < blocks.size(); ++b) {
+          const RowBlock &blk = blocks[b];
+          labels.insert(labels.end(), blk.label.begin(), blk.label.end());
+          for (size_t i = 0; i < blk.Size(); ++i) {
+            // close the page before a row that does not fit in it
+            const size_t len = blk.offset[i + 1] - blk.offset[i];
+            if (ptr.size() != 1 && PageBytes(ptr.size(), data.size() + len) > page_size) {
+              table.push_back(WritePage(fo, &offset, row_begin, ptr, data));
+              row_begin += ptr.size() - 1;
+              ptr.resize(1); data.clear();
+            }
+            for (size_t j = blk.offset[i]; j < blk.offset[i + 1]; ++j) {
+              const REntry &e = blk.data[j];
+              if (col_count.size() <= e.findex) col_count.resize(e.findex + 1, 0);
+              col_count[e.findex] += 1;
+              data.push_back(e);
+            }
+            ptr.push_back(data.size());
+          }
+        }
+      }
+      if (ptr.size() != 1) {
+        table.push_back(WritePage(fo, &offset, row_begin, ptr, data));
+      }
+      header.num_row_page = table.size();
+      header.num_row = labels.size();
+    }
+    utils::Assert(std::fflush(fo) == 0, "FMatrixPage: fail to write");
+    // group columns into pages
+    std::vector<size_t> col_bound(1, 0);
+    while (col_bound.back() < col_count.size()) {
+      size_t c = col_bound.back(), nentry = 0;
+      do {
+        nentry += col_count[c]; ++c;
+      } while (c < col_count.size() &&
+               PageBytes(c - col_bound.back() + 1, nentry + col_count[c]) <= page_size);
+      col_bound.push_back(c);
+    }
+    {// transpose, each pass collects the columns of as many pages as fit in cache_size
+      const int fdin = fileno(fo);
+      size_t pbegin = 0;
+      const size_t npage = col_bound.size() - 1;
+      std::vector<uint64_t> buf;
+      while (pbegin < npage) {
+        size_t pend = pbegin, nbytes = 0;
+        do {
+          nbytes += PageBytes(col_bound[pend + 1] - col_bound[pend],
+                              SumCount(col_count, col_bound[pend], col_bound[pend + 1]));
+          ++pend;
+        } while (pend < npage && nbytes < param.cache_size);
+        const size_t cbegin = col_bound[pbegin], cend = col_bound[pend];
+        std::vector<uint64_t> ptr(cend - cbegin + 1, 0);
+        for (size_t c = cbegin; c < cend; ++c) {
+          ptr[c - cbegin + 1] = ptr[c - cbegin] + col_count[c];
+        }
+        std::vector<REntry> data(ptr.back());
+        std::vector<uint64_t> pos(ptr.begin(), ptr.end() - 1);
+        for (size_t p = 0; p < header.num_row_page; ++p) {
+          const PageInfo &info = table[p];
+          buf.resize(info.nbytes / sizeof(uint64_t));
+          ReadAt(fdin, &buf[0], info.nbytes, info.offset);
+          const REntry *rdata = reinterpret_cast<const REntry*>(&buf[info.n + 1]);
+          for (uint64_t i = 0; i < info.n; ++i) {
+            for (uint64_t j = buf[i]; j < buf[i + 1]; ++j) {
+              const bst_uint findex = rdata[j].findex;
+              if (findex < cbegin || findex >= cend) continue;
+              data[pos[findex - cbegin]++] = REntry(static_cast<bst_uint>(info.begin + i), rdata[j].fvalue);
+            }
+          }
+        }
+        const bst_omp_uint ncol = static_cast<bst_omp_uint>(cend - cbegin);
+        #pragma omp parallel
+        {
+          std::vector<REntry> tmp;
+          #pragma omp for schedule(dynamic, 1)
+          for (bst_omp_uint c = 0; c < ncol; ++c) {
+            if (ptr[c + 1] - ptr[c] < 2) continue;
+            FMatrixS::SortByValue(&data[0] + ptr[c], &data[0] + ptr[c + 1], &tmp);
+          }
+        }
+        utils::Assert(std::fseek(fo, 0, SEEK_END) == 0, "FMatrixPage: fail to seek");
+        for (size_t p = pbegin; p < pend; ++p) {
+          const size_t c0 = col_bound[p] - cbegin, c1 = col_bound[p + 1] - cbegin;
+          std::vector<uint64_t> pptr(ptr.begin() + c0, ptr.begin() + c1 + 1);
+          for (size_t i = 0; i < pptr.size(); ++i) pptr[i] -= ptr[c0];
+          std::vector<REntry> pdata(data.begin() + ptr[c0], data.begin() + ptr[c1]);
+          table.push_back(WritePage(fo, &offset, col_bound[p], pptr, pdata));
+        }
+        utils::Assert(std::fflush(fo) == 0, "FMatrixPage: fail to write");
+        pbegin = pend;
+      }
+      header.num_col_page = npage;
+      header.num_col = col_count.size();
+      header.num_entry = SumCount(col_count, 0, col_count.size());
+    }
+    header.table_offset = offset;
+    WriteAt(fo, table.size() == 0 ? NULL : &table[0], table.size() * sizeof(PageInfo), &offset);
+    header.label_offset = offset;
+    WriteAt(fo, labels.size() == 0 ? NULL : &labels[0], labels.size() * sizeof(float), &offset);
+    // write the real header at last, so a partial file is never taken as valid
+    utils::Assert(std::fseek(fo, 0, SEEK_SET) == 0, "FMatrixPage: fail to seek");
+    utils::Assert(std::fwrite(&header, sizeof(header), 1, fo) != 0, "FMatrixPage: fail to write");
+    std::fclose(fo);
+    if (!silent) {
+      printf("%lu row pages and %lu column pages are written to %s\n",
+             (unsigned long)header.num_row_page, (unsigned long)header.num_col_page, fname);
+    }
+  }
+
+ public:
+  virtual bool HaveColAccess(void) const {
+    return fd_ >= 0;
+  }
+  virtual RowIter GetRow(size_t ridx) const {
+    const Page *p = this->GetPage(kRow, ridx);
+    const size_t i = ridx - static_cast<size_t>(p->info.begin);
+    return RowIter(p->data + p->offset[i] - 1, p->data + p->offset[i + 1] - 1);
+  }
+  virtual ColIter GetSortedCol(size_t cidx) const {
+    const Page *p = this->GetPage(kCol, cidx);
+    const size_t i = cidx - static_cast<size_t>(p->info.begin);
+    return ColIter(p->data + p->offset[i] - 1, p->data + p->offset[i + 1] - 1);
+  }
+  virtual size_t NumCol(void) const {
+    return static_cast<size_t>(header_.num_col);
+  }
+  virtual size_t NumRow(void) const {
+    return static_cast<size_t>(header_.num_row);
+  }
+  virtual size_t NumEntry(void) const {
+    return static_cast<size_t>(header_.num_entry);
+  }
+
+ private:
+  typedef int bst_omp_uint;
+  /*! \brief kind of pages */
+  enum PageKind {
+    kRow = 0,
+    kCol = 1
+  };
+  /*! \brief state of a page in cache */
+  enum PageState {
+    kEmpty = 0,
+    kQueued = 1,
+    kLoading = 2,
+    kReady = 3
+  };
+  /*! \brief header of the cache file */
+  struct Header {
+    static const uint64_t kMagic = 0x3130454741504258ULL;
+    static const uint64_t kHeaderSize = 4096;
+    uint64_t magic;
+    uint64_t num_row, num_col, num_entry;
+    uint64_t num_row_page, num_col_page;
+    uint64_t table_offset, label_offset;
+    Header(void) {
+      std::memset(this, 0, sizeof(Header));
+      magic = kMagic;
+    }
+  };
+  /*! \brief entry of page table */
+  struct PageInfo {
+    /*! \brief byte offset of the page in file */
+    uint64_t offset;
+    /*! \brief index of the first row or column in the page */
+    uint64_t begin;
+    /*! \brief number of rows or columns in the page */
+    uint64_t n;
+    /*! \brief number of bytes of the page */
+    uint64_t nbytes;
+  };
+  /*! \brief a page in the cache */
+  struct Page {
+    PageInfo info;
+    /*! \brief content when resident */
+    std::vector<uint64_t> buf;
+    /*! \brief view of the content */
+    const uint64_t *offset;
+    const REntry *data;
+    /*! \brief state of the page */
+    int state;
+    /*! \brief number of pins held by the threads */
+    int pin;
+    /*! \brief position in LRU list, valid when unpinned and resident */
+    std::list<Page*>::iterator lru;
+    bool in_lru;
+    Page(void) : offset(NULL), data(NULL), state(kEmpty), pin(0), in_lru(false) {}
+  };
+  /*! \brief per thread record of pinned pages */
+  struct ThreadSlot {
+    /*! \brief page used last time, for each kind */
+    Page *last[2];
+    /*! \brief ring of pinned pages */
+    Page *pins[kPinPerThread];
+    /*! \brief next position in ring */
+    int next;
+    /*! \brief padding to avoid false sharing */
+    char pad[64];
+    ThreadSlot(void) : next(0) {
+      last[0] = last[1] = NULL;
+      for (int i = 0; i < kPinPerThread; ++i) pins[i] = NULL;
+    }
+  };
+  /*! \brief get the page holding index idx, fast path when the thread used the page last time */
+  inline const Page *GetPage(int kind, size_t idx) const {
+    const int tid = omp_get_thread_num();
+    utils::Assert(tid < static_cast<int>(slots_.size()), "FMatrixPage: more threads than opened with");
+    ThreadSlot &s = slots_[tid];
+    const Page *p = s.last[kind];
+    if (p != NULL && idx - static_cast<size_t>(p->info.begin) < p->info.n) return p;
+    return this->Acquire(kind, idx, &s);
+  }
+  /*! \brief slow path of GetPage, make the page resident and pin it */
+  inline Page *Acquire(int kind, size_t idx, ThreadSlot *s) const {
+    const size_t pid = std::upper_bound(page_begin_[kind].begin(), page_begin_[kind].end(),
+                                        static_cast<uint64_t>(idx)) - page_begin_[kind].begin() - 1;
+    utils::Assert(pid < pages_[kind].size(), "FMatrixPage: index exceed bound");
+    Page *p = &pages_[kind][pid];
+    mutex_.Lock();
+    while (p->state == kLoading) ready_.Wait(mutex_);
+    if (p->state != kReady) {
+      // make room first, the page is counted against cache_size before it is read
+      this->Evict(p->info.nbytes);
+      p->state = kLoading;
+      resident_ += p->info.nbytes;
+      mutex_.Unlock();
+      this->ReadPage(p);
+      mutex_.Lock();
+      p->state = kReady;
+      ready_.Broadcast();
+    }
+    if (p->in_lru) {
+      lru_.erase(p->lru); p->in_lru = false;
+    }
+    p->pin += 1;
+    Page *old = s->pins[s->next];
+    s->pins[s->next] = p;
+    s->next = (s->next + 1) % kPinPerThread;
+    s->last[kind] = p;
+    if (old != NULL) {
+      bool still_pinned = false;
+      for (int i = 0; i < kPinPerThread; ++i) {
+        if (s->pins[i] == old) still_pinned = true;
+      }
+      if (!still_pinned) {
+        if (s->last[0] == old) s->last[0] = NULL;
+        if (s->last[1] == old) s->last[1] = NULL;
+      }
+      if (--old->pin == 0) {
+        lru_.push_front(old);
+        old->lru = lru_.begin(); old->in_lru = true;
+      }
+    }
+    this->Evict(0);
+    // read ahead the following pages
+    bool queued = false;
+    for (int k = 1; k <= param_.prefetch && pid + k < pages_[kind].size(); ++k) {
+      Page *q = &pages_[kind][pid + k];
+      if (q->state == kEmpty) {
+        q->state = kQueued; queue_.push_back(q); queued = true;
+      }
+    }
+    if (queued) wakeup_.Signal();
+    mutex_.Unlock();
+    return p;
+  }
+  /*! \brief evict unpinned pages until there is room for nbytes more, mutex must be held */
+  inline void Evict(size_t nbytes) const {
+    while (resident_ + nbytes > param_.cache_size && !lru_.empty()) {
+      Page *p = lru_.back();
+      lru_.pop_back();
+      p->in_lru = false;
+      std::vector<uint64_t>().swap(p->buf);
+      p->offset = NULL; p->data = NULL;
+      p->state = kEmpty;
+      resident_ -= p->info.nbytes;
+    }
+  }
+  /*! \brief read content of page from disk, called without holding the mutex */
+  inline void ReadPage(Page *p) const {
+    p->buf.resize(p->info.nbytes / sizeof(uint64_t));
+    ReadAt(fd_, &p->buf[0], p->info.nbytes, p->info.offset);
+    p->offset = &p->buf[0];
+    p->data = reinterpret_cast<const REntry*>(&p->buf[p->info.n + 1]);
+  }
+  /*! \brief loop of prefetch thread */
+  inline void PrefetchLoop(void) {
+    mutex_.Lock();
+    while (true) {
+      while (queue_.empty() && !stop_) wakeup_.Wait(mutex_);
+      if (stop_) break;
+      Page *p = queue_.front();
+      queue_.pop_front();
+      if (p->state != kQueued) continue;
+      this->Evict(p->info.nbytes);
+      if (resident_ + p->info.nbytes > param_.cache_size) {
+        // no room, the consumer will read it when needed
+        p->state = kEmpty; continue;
+      }
+      p->state = kLoading;
+      resident_ += p->info.nbytes;
+      mutex_.Unlock();
+      this->ReadPage(p);
+      mutex_.Lock();
+      p->state = kReady;
+      lru_.push_front(p);
+      p->lru = lru_.begin(); p->in_lru = true;
+      ready_.Broadcast();
+    }
+    mutex_.Unlock();
+  }
+  inline static void *PrefetchEntry(void *self) {
+    static_cast<FMatrixPage*>(self)->PrefetchLoop();
+    return NULL;
+  }
+  /*! \brief number of bytes of a page with n rows and nentry entries */
+  inline static size_t PageBytes(size_t n, size_t nentry) {
+    return (n + 1) * sizeof(uint64_t) + nentry * sizeof(REntry);
+  }
+  inline static size_t SumCount(const std::vector<size_t> &count, size_t begin, size_t end) {
+    size_t sum = 0;
+    for (size_t i = begin; i < end; ++i) sum += count[i];
+    return sum;
+  }
+  /*! \brief write a page at the end of file, return its table entry */
+  inline static PageInfo WritePage(FILE *fo, uint64_t *offset, uint64_t begin,
+                                   const std::vector<uint64_t> &ptr,
+                                   const std::vector<REntry> &data) {
+    PageInfo info;
+    info.offset = *offset;
+    info.begin = begin;
+    info.n = ptr.size() - 1;
+    info.nbytes = PageBytes(ptr.size() - 1, data.size());
+    WriteAt(fo, &ptr[0], ptr.size() * sizeof(uint64_t), offset);
+    WriteAt(fo, data.size() == 0 ? NULL : &data[0], data.size() * sizeof(REntry), offset);
+    return info;
+  }
+  inline static void WriteAt(FILE *fo, const void *dptr, size_t nbytes, uint64_t *offset) {
+    if (nbytes == 0) return;
+    utils::Assert(std::fwrite(dptr, nbytes, 1, fo) != 0, "FMatrixPage: fail to write");
+    *offset += nbytes;
+  }
+  inline static void ReadAt(int fd, void *dptr, size_t nbytes, uint64_t offset) {
+#ifndef _MSC_VER
+    char *p = static_cast<char*>(dptr);
+    while (nbytes != 0) {
+      ssize_t n = pread(fd, p, nbytes, static_cast<off_t>(offset));
+      utils::Check(n > 0, "FMatrixPage: fail to read page cache");
+      p += n; nbytes -= n; offset += n;
+    }
+#endif
+  }
+
+ private:
+  /*! \brief parameters */
+  Param param_;
+  /*! \brief header of the opened cache file */
+  Header header_;
+  /*! \brief file descriptor of the cache file */
+  int fd_;
+  /*! \brief pages of each kind */
+  mutable std::vector<Page> pages_[2];
+  /*! \brief first index of each page, for lookup */
+  std::vector<uint64_t> page_begin_[2];
+  /*! \brief per thread pins */
+  mutable std::vector<ThreadSlot> slots_;
+  /*! \brief unpinned resident pages, most recently used first */
+  mutable std::list<Page*> lru_;
+  /*! \brief pages waiting to be prefetched */
+  mutable std::deque<Page*> queue_;
+  /*! \brief lock protecting the cache state */
+  mutable utils::Mutex mutex_;
+  /*! \brief signaled when a page becomes ready */
+  mutable utils::ConditionVariable ready_;
+  /*! \brief signaled when there are prefetch requests */
+  mutable utils::ConditionVariable wakeup_;
+  /*! \brief background thread that reads pages ahead */
+  utils::Thread prefetcher_;
+  /*! \brief whether the prefetcher should stop */
+  bool stop_;
+  /*! \brief number of bytes of resident pages */
+  mutable size_t resident_;
+};
+}  // namespace io
+}  // namespace xgboost
+#endif  // XGBOOST_IO_PAGE_FMATRIX_INL_H_
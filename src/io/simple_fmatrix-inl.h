@@ -8,17 +8,57 @@
 
 #include <vector>
 #include <climits>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <inttypes.h>
 #include "../data.h"
 #include "../utils/utils.h"
 #include "../utils/io.h"
 #include "../utils/matrix_csr.h"
+#include "../utils/omp.h"
+#include "../utils/mmap.h"
+#include "../utils/thread.h"
+#include "./binary_buffer.h"
 
 namespace xgboost{
+/*!
+ * \brief a batch of rows in CSR format together with their labels,
+ *        used to fill FMatrixS block by block
+ */
+struct RowBlock {
+  /*! \brief row pointer of the block, offset[0] is always 0 */
+  std::vector<size_t> offset;
+  /*! \brief label of each row */
+  std::vector<bst_float> label;
+  /*! \brief entries of the rows */
+  std::vector<IFMatrix::REntry> data;
+  /*! \brief constructor */
+  RowBlock(void) {
+    this->Clear();
+  }
+  /*! \brief number of rows in the block */
+  inline size_t Size(void) const {
+    return offset.size() - 1;
+  }
+  /*! \brief clear the content, keep the allocated space */
+  inline void Clear(void) {
+    offset.resize(1); offset[0] = 0;
+    label.clear(); data.clear();
+  }
+};
 /*! 
- * \brief feature matrix to store training instance, in sparse CSR format
+ * \brief feature matrix to store training instance, in sparse CSR format,
+ *        the column access is built on first use, so matrices that are 
+ *        only used for prediction never pay for it
  */        
 class FMatrixS: public IFMatrix {
  public:
+  /*! \brief constructor */
+  FMatrixS(void) : col_compress_(false), col_ready_(false) {
+    this->Clear();
+  }
   /*!  \brief get number of rows */
   inline size_t NumRow(void) const {
     return row_ptr_.size() - 1;
@@ -44,98 +84,501 @@ class FMatrixS: public IFMatrix {
     row_ptr_.push_back(row_ptr_.back() + cnt);
     return row_ptr_.size() - 2;
   }
+  /*!
+   * \brief append rows of the blocks at the end of the matrix, 
+   *        rows keep the order of blocks, blocks are copied in parallel
+   * \param blocks row blocks to be appended
+   */
+  inline void AppendRows(const std::vector<RowBlock> &blocks) {
+    const int nblock = static_cast<int>(blocks.size());
+    std::vector<size_t> row_begin(nblock + 1), data_begin(nblock + 1);
+    row_begin[0] = row_ptr_.size() - 1; data_begin[0] = row_data_.size();
+    for (int i = 0; i < nblock; ++i) {
+      row_begin[i + 1] = row_begin[i] + blocks[i].Size();
+      data_begin[i + 1] = data_begin[i] + blocks[i].data.size();
+    }
+    row_ptr_.resize(row_begin[nblock] + 1);
+    row_data_.resize(data_begin[nblock]);
+    #pragma omp parallel for schedule(static, 1)
+    for (int i = 0; i < nblock; ++i) {
+      const RowBlock &blk = blocks[i];
+      for (size_t j = 1; j < blk.offset.size(); ++j) {
+        row_ptr_[row_begin[i] + j] = data_begin[i] + blk.offset[j];
+      }
+      if (blk.data.size() != 0) {
+        std::memcpy(&row_data_[data_begin[i]], &blk.data[0], blk.data.size() * sizeof(REntry));
+      }
+    }
+  }
   /*!  \brief get row iterator*/
   inline RowIter GetRow(size_t ridx) const {
     utils::Assert(!bst_debug || ridx < this->NumRow(), "row id exceed bound");
     return RowIter(&row_data_[row_ptr_[ridx]]-1, &row_data_[row_ptr_[ridx+1]]-1);
   }
  public:
-  /*!  \brief get number of colmuns */
+  /*!  \brief get number of colmuns, builds column access if needed */
   inline size_t NumCol(void) const {
-    utils::Assert(this->HaveColAccess(), 
-                  " Can not get number of column, do not have access.");
+    this->InitColAccess();
     return col_ptr_.size() - 1;
   }
-  /*!  \brief get col iterator*/
+  /*!  \brief get col iterator, builds column access if needed */
   inline ColIter GetSortedCol(size_t cidx) const {
+    this->InitColAccess();
     utils::Assert(!bst_debug || cidx < this->NumCol(), "col id exceed bound");
+    if (col_meta_.size() != 0) {
+      const ColMeta &m = col_meta_[cidx];
+      return ColIter(col_rows_.begin() + m.row_offset, m.row_bits, m.delta != 0,
+                     col_runs_.begin() + m.run_offset, m.run_bits,
+                     col_values_.begin() + m.value_offset, col_ptr_[cidx + 1] - col_ptr_[cidx]);
+    }
     return ColIter( &col_data_[ col_ptr_[cidx] ] - 1, &col_data_[ col_ptr_[cidx+1] ] - 1 );
   }
+  /*! \return whether the column access is stored in compressed form */
+  inline bool IsColCompressed(void) const {
+    return col_meta_.size() != 0;
+  }
+  /*! \return number of bytes used by the column access */
+  inline size_t ColBytes(void) const {
+    return col_ptr_.size() * sizeof(size_t) + col_data_.size() * sizeof(REntry) +
+        col_meta_.size() * sizeof(ColMeta) + col_rows_.size() + col_runs_.size() +
+        col_values_.size() * sizeof(bst_float);
+  }
+  /*! \brief set whether the column access is compressed when it is built on demand */
+  inline void SetColCompress(bool compress) {
+    col_compress_ = compress;
+  }
+  /*! 
+   * \brief build the column access if it is not built yet, called on first use of columns,
+   *        safe to call from multiple threads
+   */
+  inline void InitColAccess(void) const {
+    // the columns read after an acquire load of the flag are the ones published before its release store
+    if (__atomic_load_n(&col_ready_, __ATOMIC_ACQUIRE)) return;
+    utils::LockGuard lock(col_mutex_);
+    if (col_ready_) return;
+    const_cast<FMatrixS*>(this)->InitData(col_compress_);
+  }
+  /*! \return whether the column access has been built */
+  inline bool ColAccessReady(void) const {
+    return __atomic_load_n(&col_ready_, __ATOMIC_ACQUIRE);
+  }
   /*! \brief clear the storage */
   inline void Clear(void) {
+    col_ready_ = false;
     row_ptr_.clear();
     row_ptr_.push_back(0);
     row_data_.clear();
     col_ptr_.clear();
     col_data_.clear();
+    col_meta_.clear();
+    col_rows_.clear();
+    col_runs_.clear();
+    col_values_.clear();
   }
-  inline void InitData(void) {
-    utils::SparseCSRMBuilder<REntry> builder(col_ptr_, col_data_);
-    builder.InitBudget(0);
-    for (size_t i = 0; i < this->NumRow(); ++i) {
-      for (RowIter it = this->GetRow(i); it.Next(); ) {
-        builder.AddBudget(it.findex());
+  /*!
+   * \brief build the column access from all rows, see BuildColumns
+   * \param compress whether to store the columns in compressed form, see CompressColumns
+   */
+  inline void InitData(bool compress = false) {
+    std::vector<size_t> col_ptr;
+    std::vector<REntry> col_data;
+    this->BuildColumns(0, &col_ptr, &col_data);
+    this->SetColumns(&col_ptr, &col_data, compress);
+  }
+  /*!
+   * \brief extend the column access with rows appended after it was built,
+   *        the columns of new rows are built and sorted on their own, then merged 
+   *        into the existing sorted columns, the result equals a full rebuild
+   * \param nrow_old number of rows when the column access was built
+   */
+  inline void AppendColAccess(size_t nrow_old) {
+    utils::Assert(col_ready_, "AppendColAccess: column access is not built");
+    std::vector<size_t> add_ptr;
+    std::vector<REntry> add_data;
+    this->BuildColumns(nrow_old, &add_ptr, &add_data);
+    const size_t ncol_old = col_ptr_.size() - 1, ncol_add = add_ptr.size() - 1;
+    const unsigned ncol = static_cast<unsigned>(std::max(ncol_old, ncol_add));
+    std::vector<size_t> col_ptr(ncol + 1, 0);
+    for (unsigned i = 0; i < ncol; ++i) {
+      col_ptr[i + 1] = col_ptr[i];
+      if (i < ncol_old) col_ptr[i + 1] += col_ptr_[i + 1] - col_ptr_[i];
+      if (i < ncol_add) col_ptr[i + 1] += add_ptr[i + 1] - add_ptr[i];
+    }
+    std::vector<REntry> col_data(col_ptr.back());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (unsigned i = 0; i < ncol; ++i) {
+      REntry *out = &col_data[0] + col_ptr[i];
+      const REntry *a = NULL, *aend = NULL;
+      if (i < ncol_add && add_ptr[i] != add_ptr[i + 1]) {
+        a = &add_data[0] + add_ptr[i]; aend = &add_data[0] + add_ptr[i + 1];
+      }
+      if (i < ncol_old) {
+        // old rows come first among equal values, as in a stable sort of all rows
+        ColIter it = this->GetSortedCol(i);
+        bool valid = it.Next();
+        while (valid) {
+          if (a != aend && SortKey(a->fvalue) < SortKey(it.fvalue())) {
+            *out++ = *a++;
+          } else {
+            *out++ = REntry(it.rindex(), it.fvalue());
+            valid = it.Next();
+          }
+        }
       }
+      while (a != aend) *out++ = *a++;
     }
-    builder.InitStorage();
-    for(size_t i = 0; i < this->NumRow(); ++i) {
-      for (RowIter it = this->GetRow(i); it.Next(); ) {
-        builder.PushElem(it.findex(), REntry((bst_uint)i, it.fvalue()));
+    this->SetColumns(&col_ptr, &col_data, this->IsColCompressed());
+  }
+  /*!
+   * \brief replace the sorted columns by their compressed form, which is decoded by ColIter:
+   *        each column keeps its distinct values in increasing order, with the run length
+   *        of each value bit-packed; row indices are bit-packed with the smallest width,
+   *        either as absolute values, or as zigzag encoded difference to the previous entry,
+   *        which is small when long runs of equal values are sorted by row index
+   */
+  inline void CompressColumns(void) {
+    if (col_meta_.size() != 0 || col_ptr_.size() == 0) return;
+    const unsigned ncol = static_cast<unsigned>(col_ptr_.size() - 1);
+    std::vector<ColMeta> meta(ncol);
+    std::vector<size_t> nvalue(ncol + 1, 0);
+    // first pass: choose the encoding and count the size of each column
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (unsigned i = 0; i < ncol; ++i) {
+      const REntry *begin = col_data_.begin() + col_ptr_[i];
+      const REntry *end = col_data_.begin() + col_ptr_[i + 1];
+      uint64_t max_abs = 0, max_delta = 0, max_run = 0, run = 0;
+      size_t cnt = 0;
+      bst_uint last = 0;
+      for (const REntry *p = begin; p != end; ++p) {
+        if (p == begin || !SameValue(p[-1].fvalue, p->fvalue)) {
+          ++cnt; run = 0;
+        } else {
+          max_run = std::max(max_run, ++run);
+        }
+        max_abs = std::max(max_abs, static_cast<uint64_t>(p->findex));
+        max_delta = std::max(max_delta, ZigZag(static_cast<int64_t>(p->findex) - last));
+        last = p->findex;
       }
+      const unsigned abs_bits = NumBits(max_abs), delta_bits = NumBits(max_delta);
+      meta[i].delta = delta_bits < abs_bits ? 1 : 0;
+      meta[i].row_bits = static_cast<uint8_t>(meta[i].delta != 0 ? delta_bits : abs_bits);
+      meta[i].run_bits = static_cast<uint8_t>(NumBits(max_run));
+      nvalue[i + 1] = cnt;
     }
-    // sort columns
-    unsigned ncol = static_cast<unsigned>(this->NumCol());
+    // row and run streams of each column start at byte boundaries
+    size_t nrow_bytes = 0, nrun_bytes = 0;
     for (unsigned i = 0; i < ncol; ++i) {
-      std::sort(&col_data_[col_ptr_[i]], &col_data_[col_ptr_[i+1]], REntry::cmp_fvalue);
+      meta[i].row_offset = nrow_bytes;
+      meta[i].run_offset = nrun_bytes;
+      meta[i].value_offset = nvalue[i];
+      nrow_bytes += ((col_ptr_[i + 1] - col_ptr_[i]) * meta[i].row_bits + 7) / 8;
+      nrun_bytes += (nvalue[i + 1] * meta[i].run_bits + 7) / 8;
+      nvalue[i + 1] += nvalue[i];
     }
+    // padding so that the decoder can always load 8 bytes
+    std::vector<unsigned char> rows(nrow_bytes + 8, 0), runs(nrun_bytes + 8, 0);
+    std::vector<bst_float> values(nvalue[ncol]);
+    // second pass: encode, each column only touches its own bytes
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (unsigned i = 0; i < ncol; ++i) {
+      const ColMeta &m = meta[i];
+      const REntry *begin = col_data_.begin() + col_ptr_[i];
+      const REntry *end = col_data_.begin() + col_ptr_[i + 1];
+      size_t row_pos = 0, run_pos = 0, k = m.value_offset;
+      bst_uint last = 0, run = 0;
+      for (const REntry *p = begin; p != end; ++p) {
+        if (p == begin || !SameValue(p[-1].fvalue, p->fvalue)) {
+          if (p != begin) {
+            WriteBits(&runs[m.run_offset], run_pos, run - 1, m.run_bits);
+            run_pos += m.run_bits;
+          }
+          values[k++] = p->fvalue; run = 0;
+        }
+        ++run;
+        const unsigned v = m.delta != 0 ?
+            static_cast<unsigned>(ZigZag(static_cast<int64_t>(p->findex) - last)) : p->findex;
+        WriteBits(&rows[m.row_offset], row_pos, v, m.row_bits);
+        row_pos += m.row_bits;
+        last = p->findex;
+      }
+      if (begin != end) WriteBits(&runs[m.run_offset], run_pos, run - 1, m.run_bits);
+    }
+    col_meta_.swap(meta);
+    col_rows_.swap(rows);
+    col_runs_.swap(runs);
+    col_values_.swap(values);
+    std::vector<REntry> empty;
+    col_data_.swap(empty);
   }
-  /*! \return whether column access is enabled */
+  /*! \return whether column access is enabled, always true since it is built on demand */
   inline bool HaveColAccess(void) const {
-    return col_ptr_.size() != 0 && col_data_.size() == row_data_.size();
+    return true;
   }
   /*!
-  * \brief save data to binary stream 
-  *        note: since we have size_t in ptr, 
-  *              the function is not consistent between 64bit and 32bit machine
-  * \param fo output stream
-  */
-  inline void SaveBinary(utils::IStream &fo) const {
-    FMatrixS::SaveBinary(fo, row_ptr_, row_data_);
-    int col_access = this->HaveColAccess() ? 1 : 0;
-    fo.Write(&col_access, sizeof(int));
-    if (col_access != 0) {
-      FMatrixS::SaveBinary(fo, col_ptr_, col_data_);
+   * \brief add the sections of the matrix to a binary buffer writer,
+   *        the matrix must not change until the writer is done
+   * \param fo the buffer writer
+   */
+  inline void SaveBinary(io::BufferWriter *fo) const {
+    fo->header.num_row = this->NumRow();
+    fo->header.num_entry = this->NumEntry();
+    fo->AddPtrSection(io::BufferHeader::kRowPtr, row_ptr_.begin(), row_ptr_.size());
+    fo->AddSection(io::BufferHeader::kRowData, row_data_.begin(), row_data_.size() * sizeof(REntry),
+                   sizeof(REntry));
+    if (this->ColAccessReady()) {
+      fo->header.flags |= io::BufferHeader::kColAccess;
+      fo->header.num_col = col_ptr_.size() - 1;
+      fo->AddPtrSection(io::BufferHeader::kColPtr, col_ptr_.begin(), col_ptr_.size());
+      if (this->IsColCompressed()) {
+        fo->header.flags |= io::BufferHeader::kColCompressed;
+        fo->AddSection(io::BufferHeader::kColMeta, col_meta_.begin(), col_meta_.size() * sizeof(ColMeta),
+                       sizeof(ColMeta));
+        fo->AddSection(io::BufferHeader::kColRows, col_rows_.begin(), col_rows_.size());
+        fo->AddSection(io::BufferHeader::kColRuns, col_runs_.begin(), col_runs_.size());
+        fo->AddSection(io::BufferHeader::kColValues, col_values_.begin(),
+                       col_values_.size() * sizeof(bst_float), sizeof(bst_float));
+      } else {
+        fo->AddSection(io::BufferHeader::kColData, col_data_.begin(), col_data_.size() * sizeof(REntry),
+                       sizeof(REntry));
+      }
     }
   }
   /*!
-  * \brief load data from binary stream 
+   * \brief load data from a memory mapped binary buffer, 
+   *        the data is served directly from the mapped memory without copy,
+   *        the reader must stay open as long as the matrix is used
+   * \param fi the buffer reader
+   */
+  inline void LoadBinary(const io::BufferReader &fi) {
+    this->Clear();
+    LoadPtr(fi, io::BufferHeader::kRowPtr, &row_ptr_);
+    size_t n;
+    const REntry *dptr = fi.Section<REntry>(io::BufferHeader::kRowData, &n);
+    row_data_.SetView(dptr, n);
+    utils::Check(row_ptr_.size() == fi.header().num_row + 1 && n == row_ptr_.back(),
+                 "binary buffer: inconsistent row data");
+    if ((fi.header().flags & io::BufferHeader::kColAccess) != 0) {
+      LoadPtr(fi, io::BufferHeader::kColPtr, &col_ptr_);
+      utils::Check(col_ptr_.size() == fi.header().num_col + 1 && row_data_.size() == col_ptr_.back(),
+                   "binary buffer: inconsistent column data");
+      if ((fi.header().flags & io::BufferHeader::kColCompressed) != 0) {
+        const ColMeta *meta = fi.Section<ColMeta>(io::BufferHeader::kColMeta, &n);
+        utils::Check(n == fi.header().num_col, "binary buffer: inconsistent column data");
+        col_meta_.SetView(meta, n);
+        const unsigned char *bytes = fi.Section<unsigned char>(io::BufferHeader::kColRows, &n);
+        col_rows_.SetView(bytes, n);
+        bytes = fi.Section<unsigned char>(io::BufferHeader::kColRuns, &n);
+        col_runs_.SetView(bytes, n);
+        const bst_float *values = fi.Section<bst_float>(io::BufferHeader::kColValues, &n);
+        col_values_.SetView(values, n);
+      } else {
+        dptr = fi.Section<REntry>(io::BufferHeader::kColData, &n);
+        col_data_.SetView(dptr, n);
+        utils::Check(n == col_ptr_.back(), "binary buffer: inconsistent column data");
+      }
+      col_ready_ = true;
+    }
+  }
+  /*!
+  * \brief load data from binary stream in the old unversioned format
   *        note: since we have size_t in ptr, 
   *              the function is not consistent between 64bit and 32bit machin
   * \param fi input stream
   */
   inline void LoadBinary(utils::IStream &fi) {
-    FMatrixS::LoadBinary(fi, row_ptr_, row_data_);
+    std::vector<size_t> ptr;
+    std::vector<REntry> data;
+    FMatrixS::LoadBinary(fi, ptr, data);
+    row_ptr_.swap(ptr); row_data_.swap(data);
+    col_ptr_.clear(); col_data_.clear();
     int col_access;                
     fi.Read(&col_access, sizeof(int));
     if (col_access != 0) {
-      FMatrixS::LoadBinary(fi, col_ptr_, col_data_);
+      FMatrixS::LoadBinary(fi, ptr, data);
+      col_ptr_.swap(ptr); col_data_.swap(data);
+      col_ready_ = true;
+    }
+  }
+  /*!
+   * \brief stable sort of entries by feature value, LSD radix sort on 
+   *        the order preserving integer image of the float, small ranges use stable_sort
+   * \param begin start of range
+   * \param end end of range
+   * \param tmp temp space
+   */
+  inline static void SortByValue(REntry *begin, REntry *end, std::vector<REntry> *tmp) {
+    const size_t n = end - begin;
+    if (n < 64) {
+      std::stable_sort(begin, end, REntry::cmp_fvalue);
+      return;
+    }
+    // histogram of the four bytes, computed in one pass
+    size_t hist[4][256];
+    std::memset(hist, 0, sizeof(hist));
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t key = SortKey(begin[i].fvalue);
+      hist[0][key & 0xff] += 1;
+      hist[1][(key >> 8) & 0xff] += 1;
+      hist[2][(key >> 16) & 0xff] += 1;
+      hist[3][key >> 24] += 1;
+    }
+    tmp->resize(n);
+    REntry *src = begin, *dst = &(*tmp)[0];
+    for (int pass = 0; pass < 4; ++pass) {
+      size_t *h = hist[pass];
+      // skip the byte when all keys share it
+      if (h[(SortKey(begin[0].fvalue) >> (pass * 8)) & 0xff] == n) continue;
+      size_t start = 0;
+      for (int k = 0; k < 256; ++k) {
+        size_t cnt = h[k]; h[k] = start; start += cnt;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        dst[h[(SortKey(src[i].fvalue) >> (pass * 8)) & 0xff]++] = src[i];
+      }
+      std::swap(src, dst);
     }
+    if (src != begin) std::memcpy(begin, src, n * sizeof(REntry));
+  }
+  /*! \brief map float to unsigned integer with the same order, -0 and +0 are equal */
+  inline static uint32_t SortKey(bst_float fvalue) {
+    uint32_t u;
+    std::memcpy(&u, &fvalue, sizeof(u));
+    if (u == 0x80000000U) u = 0;
+    return (u & 0x80000000U) != 0 ? ~u : (u | 0x80000000U);
   }
  private:
+  // the lock can not be shared between copies
+  FMatrixS(const FMatrixS &other);
+  FMatrixS &operator=(const FMatrixS &other);
   /*!
-  * \brief save data to binary stream 
-  * \param fo output stream
-  * \param ptr pointer data
-  * \param data data content
+   * \brief transpose rows [row_begin, NumRow()) into sorted columns, the transpose is done
+   *        by all threads over disjoint row ranges, columns are then sorted by feature value 
+   *        with a stable radix sort, larger columns are scheduled first
+   * \param row_begin first row
+   * \param out_ptr output column pointer
+   * \param out_data output column entries
+   */
+  inline void BuildColumns(size_t row_begin, std::vector<size_t> *out_ptr,
+                           std::vector<REntry> *out_data) const {
+    const int nthread = omp_get_max_threads();
+    const size_t nrow = this->NumRow() - row_begin;
+    std::vector<size_t> &col_ptr = *out_ptr;
+    std::vector<REntry> &col_data = *out_data;
+    utils::ParallelSparseCSRMBuilder<REntry> builder(col_ptr, col_data, nthread);
+    builder.InitBudget(0);
+    #pragma omp parallel for schedule(static, 1) num_threads(nthread)
+    for (int tid = 0; tid < nthread; ++tid) {
+      const size_t begin = row_begin + nrow * tid / nthread;
+      const size_t end = row_begin + nrow * (tid + 1) / nthread;
+      for (size_t i = begin; i < end; ++i) {
+        for (RowIter it = this->GetRow(i); it.Next(); ) {
+          builder.AddBudget(it.findex(), tid);
+        }
+      }
+    }
+    builder.InitStorage();
+    #pragma omp parallel for schedule(static, 1) num_threads(nthread)
+    for (int tid = 0; tid < nthread; ++tid) {
+      const size_t begin = row_begin + nrow * tid / nthread;
+      const size_t end = row_begin + nrow * (tid + 1) / nthread;
+      for (size_t i = begin; i < end; ++i) {
+        for (RowIter it = this->GetRow(i); it.Next(); ) {
+          builder.PushElem(it.findex(), REntry((bst_uint)i, it.fvalue()), tid);
+        }
+      }
+    }
+    // sort columns, largest first so that the work is balanced among threads
+    const unsigned ncol = static_cast<unsigned>(col_ptr.size() - 1);
+    std::vector< std::pair<size_t, unsigned> > order(ncol);
+    for (unsigned i = 0; i < ncol; ++i) {
+      order[i] = std::make_pair(col_ptr[i + 1] - col_ptr[i], i);
+    }
+    std::sort(order.begin(), order.end(), std::greater< std::pair<size_t, unsigned> >());
+    #pragma omp parallel num_threads(nthread)
+    {
+      std::vector<REntry> tmp;
+      #pragma omp for schedule(dynamic, 1)
+      for (unsigned j = 0; j < ncol; ++j) {
+        const unsigned i = order[j].second;
+        if (col_ptr[i + 1] - col_ptr[i] < 2) continue;
+        SortByValue(&col_data[col_ptr[i]], &col_data[0] + col_ptr[i + 1], &tmp);
+      }
+    }
+  }
+  /*!
+   * \brief use the sorted columns as column access, and publish it
+   * \param col_ptr column pointer, swapped into the matrix
+   * \param col_data column entries, swapped into the matrix
+   * \param compress whether to compress the columns
+   */
+  inline void SetColumns(std::vector<size_t> *col_ptr, std::vector<REntry> *col_data, bool compress) {
+    // clear first, so that views of the old columns are dropped without copy
+    col_ptr_.clear(); col_data_.clear();
+    col_ptr_.swap(*col_ptr);
+    col_data_.swap(*col_data);
+    col_meta_.clear(); col_rows_.clear(); col_runs_.clear(); col_values_.clear();
+    if (compress) this->CompressColumns();
+    // publish the columns before the flag, see InitColAccess
+    __atomic_store_n(&col_ready_, true, __ATOMIC_RELEASE);
+  }
+  /*! \brief layout of a compressed column */
+  struct ColMeta {
+    /*! \brief byte offset of packed row indices in col_rows_ */
+    uint64_t row_offset;
+    /*! \brief byte offset of packed run lengths in col_runs_ */
+    uint64_t run_offset;
+    /*! \brief index of the first distinct value in col_values_ */
+    uint64_t value_offset;
+    /*! \brief bit width of row indices */
+    uint8_t row_bits;
+    /*! \brief bit width of run lengths */
+    uint8_t run_bits;
+    /*! \brief whether row indices are delta encoded */
+    uint8_t delta;
+    /*! \brief reserved, keeps the structure 8 byte aligned */
+    uint8_t reserved[5];
+  };
+  /*! \brief bitwise equality of values, so that the compression is lossless */
+  inline static bool SameValue(bst_float a, bst_float b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+  }
+  /*! \brief map signed difference to unsigned integer, small magnitude to small value */
+  inline static uint64_t ZigZag(int64_t v) {
+    return v < 0 ? (static_cast<uint64_t>(-(v + 1)) << 1) | 1 : static_cast<uint64_t>(v) << 1;
+  }
+  /*! \return number of bits needed to represent v */
+  inline static unsigned NumBits(uint64_t v) {
+    unsigned n = 0;
+    while (v != 0) {
+      ++n; v >>= 1;
+    }
+    return n;
+  }
+  /*! \brief write nbits bits of v at bit position pos, touching only the bytes it covers */
+  inline static void WriteBits(unsigned char *base, size_t pos, unsigned v, unsigned nbits) {
+    while (nbits != 0) {
+      const unsigned off = static_cast<unsigned>(pos & 7);
+      const unsigned n = std::min(8U - off, nbits);
+      base[pos >> 3] |= static_cast<unsigned char>((v & ((1U << n) - 1U)) << off);
+      v >>= n; pos += n; nbits -= n;
+    }
+  }
+  /*!
+  * \brief load pointer section, view it in place when size_t is 64 bit
+  * \param fi buffer reader
+  * \param type section type
+  * \param ptr the pointer array
   */
-  inline static void SaveBinary(utils::IStream &fo, 
-                                const std::vector<size_t> &ptr, 
-                                const std::vector<REntry> &data) {
-    size_t nrow = ptr.size() - 1;
-    fo.Write(&nrow, sizeof(size_t));
-    fo.Write(&ptr[0], ptr.size()*sizeof(size_t));
-    if (data.size() != 0) {
-      fo.Write(&data[0], data.size()*sizeof(REntry));
+  inline static void LoadPtr(const io::BufferReader &fi, int type, 
+                             utils::MappedArray<size_t> *ptr) {
+    size_t n;
+    const uint64_t *dptr = fi.Section<uint64_t>(type, &n);
+    utils::Check(n != 0, "binary buffer: missing pointer section");
+    if (sizeof(size_t) == sizeof(uint64_t)) {
+      ptr->SetView(reinterpret_cast<const size_t*>(dptr), n);
+    } else {
+      std::vector<size_t> tmp(dptr, dptr + n);
+      ptr->swap(tmp);
     }
   }
   /*!
@@ -159,13 +602,27 @@ class FMatrixS: public IFMatrix {
   }  
  protected:
   /*! \brief row pointer of CSR sparse storage */
-  std::vector<size_t> row_ptr_;
+  utils::MappedArray<size_t> row_ptr_;
   /*! \brief data in the row */
-  std::vector<REntry> row_data_;
+  utils::MappedArray<REntry> row_data_;
   /*! \brief column pointer of CSC format */
-  std::vector<size_t> col_ptr_;
-  /*! \brief column datas */
-  std::vector<REntry> col_data_;
+  utils::MappedArray<size_t> col_ptr_;
+  /*! \brief column datas, empty when the columns are compressed */
+  utils::MappedArray<REntry> col_data_;
+  /*! \brief layout of each compressed column */
+  utils::MappedArray<ColMeta> col_meta_;
+  /*! \brief packed row indices of compressed columns */
+  utils::MappedArray<unsigned char> col_rows_;
+  /*! \brief packed run lengths of compressed columns */
+  utils::MappedArray<unsigned char> col_runs_;
+  /*! \brief distinct values of compressed columns */
+  utils::MappedArray<bst_float> col_values_;
+  /*! \brief whether column access built on demand is compressed */
+  bool col_compress_;
+  /*! \brief whether column access is built, read without the lock by atomic acquire */
+  bool col_ready_;
+  /*! \brief lock of building column access on demand */
+  mutable utils::Mutex col_mutex_;
 };
 
 }  // namespace xgboost
@@ -10,11 +10,21 @@
  *        label <nonzero feature dimension> [feature index:feature value]+
  */
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 #include <vector>
+#include <algorithm>
 #include "../data.h"
 #include "../utils/utils.h"
 #include "../utils/io.h"
+#include "../utils/omp.h"
+#include "../utils/timer.h"
 #include "../io/simple_fmatrix-inl.h"
+#include "../io/libsvm_parser.h"
+#include "../io/binary_buffer.h"
+#include "../io/page_fmatrix-inl.h"
+#include "../io/dense_fmatrix-inl.h"
 
 namespace xgboost {
 namespace learner {
@@ -27,119 +37,359 @@ struct DMatrix {
   FMatrixS data;
   /*! \brief label of each instance */
   std::vector<float> labels;
+  /*! \brief root of each instance in a forest with multiple roots, empty unless a group file is used */
+  std::vector<unsigned> root_index;
  public:
   /*! \brief default constructor */
-  DMatrix(void) {}
+  DMatrix(void) : num_feature(0), fmat_(&data), dense_threshold_(0.5f), buffer_compress_(0), use_group_(0),
+                  src_size_(0), src_hash_(0) {}
+  /*! 
+   * \brief set parameters of data loading
+   * \param name name of the parameter
+   * \param val  value of the parameter
+   */
+  inline void SetParam(const char *name, const char *val) {
+    if (!strcmp(name, "col_compress")) data.SetColCompress(atoi(val) != 0);
+    if (!strcmp(name, "dense_threshold")) dense_threshold_ = static_cast<float>(atof(val));
+    if (!strcmp(name, "buffer_compress")) buffer_compress_ = atoi(val);
+    if (!strcmp(name, "use_group")) use_group_ = atoi(val);
+    page_param_.SetParam(name, val);
+  }
+  /*! \brief the feature matrix used by learner, either data or an external memory matrix */
+  inline const IFMatrix &fmat(void) const {
+    return *fmat_;
+  }
 
   /*! \brief get the number of instances */
   inline size_t Size() const {
     return labels.size();
   }
   /*! 
-  * \brief load from text file 
-  * \param fname name of text data
+  * \brief load from text file, the rows of all files are concatenated
+  * \param fname name of text data, a comma separated list of files or glob patterns
   * \param silent whether print information or not
   */            
   inline void LoadText(const char* fname, bool silent = false) {
-    data.Clear();
-    FILE* file = utils::FopenCheck(fname, "r");
-    float label; bool init = true;
-    char tmp[1024];
-    std::vector<bst_uint> findex;
-    std::vector<bst_float> fvalue;
-
-    while (fscanf(file, "%s", tmp) == 1) {
-      unsigned index; float value;
-      if (sscanf(tmp, "%u:%f", &index, &value) == 2) {
-        findex.push_back(index); fvalue.push_back(value);
-      } else {
-        if (!init) {
-          labels.push_back(label);
-          data.AddRow(findex, fvalue);
-        }
-        findex.clear(); fvalue.clear();
-        utils::Assert(sscanf(tmp, "%f", &label) == 1, "invalid format");
-        init = false;
+    this->Reset(); labels.clear();
+    double tstart = utils::GetTime();
+    io::LibSVMParser parser(fname);
+    while (parser.Next()) {
+      const std::vector<RowBlock> &blocks = parser.Blocks();
+      data.AppendRows(blocks);
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        labels.insert(labels.end(), blocks[i].label.begin(), blocks[i].label.end());
       }
     }
-
-    labels.push_back(label);
-    data.AddRow(findex, fvalue);
-    // initialize column support as well
-    data.InitData();
+    double tparse = utils::GetTime() - tstart;
+    this->UpdateInfo();
+    this->SetSource(parser.Files(), parser.BytesRead());
 
     if (!silent) {
       printf("%ux%u matrix with %lu entries is loaded from %s\n", 
-          (unsigned)data.NumRow(), (unsigned)data.NumCol(), (unsigned long)data.NumEntry(), fname);
+          (unsigned)data.NumRow(), num_feature, (unsigned long)data.NumEntry(), fname);
+      double mb = parser.BytesRead() / 1048576.0;
+      printf("parsed %.1f MB from %lu files in %.2f sec, %.1f MB/sec\n", mb,
+             (unsigned long)parser.Files().size(), tparse, mb / std::max(tparse, 1e-6));
     }
-    fclose(file);
   }
   /*! 
-  * \brief load from binary file 
+  * \brief load from binary file, the buffer is memory mapped and 
+  *        the feature data is used in place without copy;
+  *        compressed buffers and buffers in the old unversioned format are read into memory
   * \param fname name of binary data
   * \param silent whether print information or not
   * \return whether loading is success
   */
   inline bool LoadBinary(const char* fname, bool silent = false) {
-    FILE *fp = fopen64(fname, "rb");
-    if (fp == NULL) return false;                
-    utils::FileStream fs(fp);
-    data.LoadBinary(fs);
-    labels.resize(data.NumRow());
-    utils::Assert(fs.Read(&labels[0], sizeof(float)*data.NumRow()) != 0, "DMatrix LoadBinary");
-    fs.Close();
-    // initialize column support as well
-    data.InitData();
+    this->Reset();
+    if (buffer_.Open(fname)) {
+      data.LoadBinary(buffer_);
+      size_t n;
+      const float *label = buffer_.Section<float>(io::BufferHeader::kLabel, &n);
+      utils::Check(n == data.NumRow(), "binary buffer: inconsistent labels");
+      labels.assign(label, label + n);
+      src_size_ = buffer_.header().src_size;
+      src_hash_ = buffer_.header().src_hash;
+    } else {
+      FILE *fp = fopen64(fname, "rb");
+      if (fp == NULL) return false;                
+      utils::FileStream fs(fp);
+      data.LoadBinary(fs);
+      labels.resize(data.NumRow());
+      utils::Assert(fs.Read(&labels[0], sizeof(float)*data.NumRow()) != 0, "DMatrix LoadBinary");
+      fs.Close();
+    }
+    this->UpdateInfo();
 
     if (!silent) {
-      printf("%ux%u matrix with %lu entries is loaded from %s\n", 
-             (unsigned)data.NumRow(), (unsigned)data.NumCol(), (unsigned long)data.NumEntry(), fname);
+      printf("%ux%u matrix with %lu entries is loaded from %s%s\n", 
+             (unsigned)data.NumRow(), num_feature, (unsigned long)data.NumEntry(), fname,
+             data.ColAccessReady() ? ", with column access" : "");
     }
     return true;
   }
   /*! 
-  * \brief save to binary file
+  * \brief save to binary file, compressed in blocks if buffer_compress is set
   * \param fname name of binary data
   * \param silent whether print information or not
+  * \param with_col whether to build the column access and keep it in the buffer
   */
-  inline void SaveBinary(const char* fname, bool silent = false) {
-    // initialize column support as well
-    data.InitData();
+  inline void SaveBinary(const char* fname, bool silent = false, bool with_col = false) {
+    if (with_col) data.InitColAccess();
 
-    utils::FileStream fs(utils::FopenCheck(fname, "wb"));
-    data.SaveBinary(fs);
-    fs.Write(&labels[0], sizeof(float)*data.NumRow());
+    io::BufferWriter writer;
+    writer.compress = buffer_compress_ != 0;
+    writer.header.src_size = src_size_;
+    writer.header.src_hash = src_hash_;
+    data.SaveBinary(&writer);
+    writer.AddSection(io::BufferHeader::kLabel, labels.size() == 0 ? NULL : &labels[0],
+                      labels.size() * sizeof(float), sizeof(float));
+    // write to a temp file and rename it, so that a buffer being mapped is never overwritten
+    std::string tmp = std::string(fname) + ".tmp";
+    utils::FileStream fs(utils::FopenCheck(tmp.c_str(), "wb"));
+    writer.Write(fs);
     fs.Close();
+    utils::Check(std::rename(tmp.c_str(), fname) == 0, "fail to rename %s to %s", tmp.c_str(), fname);
     if (!silent) {
-      printf("%ux%u matrix with %lu entries is saved to %s\n", 
-             (unsigned)data.NumRow(), (unsigned)data.NumCol(), (unsigned long)data.NumEntry(), fname);
+      printf("%ux%u matrix with %lu entries is saved to %s%s\n", 
+             (unsigned)data.NumRow(), num_feature, (unsigned long)data.NumEntry(), fname,
+             data.ColAccessReady() ? ", with column access" : "");
+    }
+  }
+  /*! 
+  * \brief append the rows added to the end of text source since the data was loaded,
+  *        only the new text is parsed, and the column access, if built, is updated
+  *        by merging the sorted columns of new rows
+  * \param fname name of text data, a comma separated list of files or glob patterns
+  * \param silent whether print information or not
+  * \return whether any row is appended
+  */
+  inline bool AppendText(const char *fname, bool silent = false) {
+    if (src_size_ == 0 || fmat_ != &data) return false;
+    std::vector<std::string> files;
+    io::LibSVMParser::ListFiles(fname, &files);
+    for (size_t i = 0; i < files.size(); ++i) {
+      FILE *fp = fopen64(files[i].c_str(), "rb");
+      if (fp == NULL) return false;
+      fclose(fp);
+    }
+    const size_t total = io::LibSVMParser::TotalSize(files);
+    if (total <= src_size_) return false;
+    if (io::LibSVMParser::Fingerprint(files, src_size_) != src_hash_) {
+      if (!silent) {
+        printf("warning: %s is modified rather than appended since the data was loaded\n", fname);
+      }
+      return false;
+    }
+    double tstart = utils::GetTime();
+    const size_t nrow_old = data.NumRow();
+    io::LibSVMParser parser(fname, 64UL << 20, src_size_);
+    while (parser.Next()) {
+      const std::vector<RowBlock> &blocks = parser.Blocks();
+      data.AppendRows(blocks);
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        labels.insert(labels.end(), blocks[i].label.begin(), blocks[i].label.end());
+      }
+    }
+    if (data.ColAccessReady()) data.AppendColAccess(nrow_old);
+    this->UpdateInfo(nrow_old);
+    this->SetSource(files, src_size_ + parser.BytesRead());
+    if (!silent) {
+      printf("%lu rows are appended from %s in %.2f sec\n",
+             (unsigned long)(data.NumRow() - nrow_old), fname, utils::GetTime() - tstart);
+    }
+    return true;
+  }
+  /*! 
+  * \brief load data into external memory, the rows and sorted columns are kept
+  *        as pages in a cache file, and only a bounded number of pages stay in memory
+  * \param fname name of text data
+  * \param cache name of the page cache file, created from text data if it does not exist
+  * \param silent whether print information or not
+  */
+  inline void LoadPage(const char *fname, const char *cache, bool silent = false) {
+    this->Reset();
+    if (!page_.Open(cache, page_param_, &labels)) {
+      io::FMatrixPage::Build(fname, cache, page_param_, silent);
+      utils::Check(page_.Open(cache, page_param_, &labels), "fail to open page cache %s", cache);
+    }
+    fmat_ = &page_;
+    num_feature = static_cast<unsigned>(page_.NumCol());
+    if (!silent) {
+      printf("%ux%u matrix with %lu entries is loaded from %s in external memory\n", 
+             (unsigned)page_.NumRow(), num_feature, (unsigned long)page_.NumEntry(), cache);
     }
   }
   /*! 
   * \brief cache load data given a file name, if filename ends with .buffer, direct load binary
   *        otherwise the function will first check if fname + '.buffer' exists,
+  *        the buffer of a list of files or glob patterns is named as in BufferName,
   *        if binary buffer exists, it will reads from binary buffer, otherwise, it will load from text file,
   *        and try to create a buffer file 
+  *        if filename is in the form of text#cache, the data is loaded into external memory
+  *        if rows are appended to the text since the buffer was built, only the new rows 
+  *        are parsed and the buffer is updated;
+  *        the roots of the instances are read from the text name + '.group' when use_group is set, see LoadGroup
   * \param fname name of binary data
   * \param silent whether print information or not
   * \param savebuffer whether do save binary buffer if it is text
+  * \param training whether the data is used for training, column access of training data
+  *        is kept in the binary buffer, other data never builds column access
+  *        data in memory is switched to dense storage when its density reaches dense_threshold
   */
-  inline void CacheLoad(const char *fname, bool silent = false, bool savebuffer = true) {
+  inline void CacheLoad(const char *fname, bool silent = false, bool savebuffer = true,
+                        bool training = false) {
+    const char *sep = strchr(fname, '#');
+    if (sep != NULL) {
+      std::string text(fname, sep - fname);
+      this->LoadPage(text.c_str(), sep + 1, silent);
+      this->LoadGroup(text.c_str(), silent); return;
+    }
     int len = strlen(fname);
     if (len > 8 && !strcmp(fname + len - 7, ".buffer")) {
-      this->LoadBinary(fname, silent); return;
+      this->LoadBinary(fname, silent);
+      this->LoadGroup(std::string(fname, len - 7).c_str(), silent);
+      this->SelectDense(silent); return;
     }
-    char bname[1024];
-    sprintf(bname, "%s.buffer", fname);
-    if (!this->LoadBinary(bname, silent)) {
+    const std::string bname = BufferName(fname);
+    if (!this->LoadBinary(bname.c_str(), silent)) {
       this->LoadText(fname, silent);
-      if (savebuffer) this->SaveBinary(bname, silent);
+      if (savebuffer) this->SaveBinary(bname.c_str(), silent, training);
+    } else if (this->AppendText(fname, silent) && savebuffer) {
+      this->SaveBinary(bname.c_str(), silent, training);
+    }
+    this->LoadGroup(fname, silent);
+    this->SelectDense(silent);
+  }
+  /*! 
+  * \brief load the roots of the instances from fname + '.group' when use_group is set,
+  *        clear them if it is not set or the file does not exist;
+  *        each line is the size of a group, groups are consecutive instances, group k uses root k,
+  *        so the trees need bst:num_roots of at least the number of groups
+  * \param fname name of text data
+  * \param silent whether print information or not
+  */
+  inline void LoadGroup(const char *fname, bool silent = false) {
+    root_index.clear();
+    if (use_group_ == 0) return;
+    std::string gname = std::string(fname) + ".group";
+    FILE *fp = fopen64(gname.c_str(), "r");
+    if (fp == NULL) {
+      // the setting also applies to evaluation data, which may have no groups, so it is not an error
+      utils::Warning(("use_group is set but " + gname + " can not be opened, all instances use root 0").c_str());
+      return;
+    }
+    unsigned nrow, ngroup = 0;
+    while (fscanf(fp, "%u", &nrow) == 1) {
+      root_index.insert(root_index.end(), nrow, ngroup++);
+    }
+    fclose(fp);
+    utils::Check(root_index.size() == this->Size(),
+                 "%s: groups cover %lu instances, data has %lu", gname.c_str(),
+                 static_cast<unsigned long>(root_index.size()), static_cast<unsigned long>(this->Size()));
+    if (!silent) {
+      printf("%u groups are loaded from %s\n", ngroup, gname.c_str());
     }
   }
 private:
-  /*! \brief update num_feature info */
-  inline void UpdateInfo( void ){
-  };
+  // the mapped buffer can not be shared between copies
+  DMatrix(const DMatrix &other);
+  DMatrix &operator=(const DMatrix &other);
+  /*!
+   * \brief name of the binary buffer of text data, fname + ".buffer" for a single file;
+   *        a list of files or glob patterns is named by the path before its first ',' or wildcard,
+   *        followed by a hash of the whole list, since the list can be long and unfit for a file name;
+   *        the name is hidden so that the patterns, which do not match a leading dot, never match it
+   */
+  inline static std::string BufferName(const char *fname) {
+    const size_t len = strcspn(fname, ",*?[");
+    if (fname[len] == '\0') return std::string(fname) + ".buffer";
+    const std::string prefix(fname, len);
+    const size_t pos = prefix.rfind('/');
+    const size_t base = pos == std::string::npos ? 0 : pos + 1;
+    std::string bname = prefix.substr(0, base) + "." + prefix.substr(base);
+    if (base == prefix.length()) bname += "data";
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (const char *p = fname; *p != '\0'; ++p) {
+      h = (h ^ static_cast<unsigned char>(*p)) * 1099511628211ULL;
+    }
+    char hex[32];
+    sprintf(hex, ".%016llx.buffer", static_cast<unsigned long long>(h));
+    return bname + hex;
+  }
+  /*! 
+   * \brief update num_feature info, the maximum feature index plus one
+   * \param row_begin rows before row_begin are already counted in num_feature
+   */
+  inline void UpdateInfo(size_t row_begin = 0) {
+    const int nthread = omp_get_max_threads();
+    const size_t nrow = data.NumRow() - row_begin;
+    std::vector<unsigned> fmax(nthread, row_begin == 0 ? 0 : num_feature);
+    #pragma omp parallel for schedule(static, 1) num_threads(nthread)
+    for (int tid = 0; tid < nthread; ++tid) {
+      const size_t begin = row_begin + nrow * tid / nthread;
+      const size_t end = row_begin + nrow * (tid + 1) / nthread;
+      for (size_t i = begin; i < end; ++i) {
+        for (IFMatrix::RowIter it = data.GetRow(i); it.Next(); ) {
+          fmax[tid] = std::max(fmax[tid], it.findex() + 1);
+        }
+      }
+    }
+    num_feature = *std::max_element(fmax.begin(), fmax.end());
+  }
+  /*! 
+   * \brief remember the text source of data, so that rows appended later can be detected
+   * \param files text files
+   * \param nbytes number of bytes parsed, a source that does not end a line is not remembered
+   */
+  inline void SetSource(const std::vector<std::string> &files, size_t nbytes) {
+    src_size_ = 0; src_hash_ = 0;
+    if (nbytes == 0) return;
+    std::string last;
+    io::LibSVMParser::ReadRange(files, nbytes - 1, nbytes, &last);
+    if (last[0] != '\n' && last[0] != '\r') return;
+    src_size_ = nbytes;
+    src_hash_ = io::LibSVMParser::Fingerprint(files, nbytes);
+  }
+  /*! \brief release the current content, and use data as feature matrix */
+  inline void Reset(void) {
+    data.Clear(); buffer_.Close(); page_.Close(); dense_.Clear();
+    fmat_ = &data; num_feature = 0;
+    src_size_ = 0; src_hash_ = 0;
+  }
+  /*! \brief move data into dense storage if its density reaches dense_threshold */
+  inline void SelectDense(bool silent) {
+    if (fmat_ != &data || data.NumRow() == 0 || num_feature == 0) return;
+    const double density = static_cast<double>(data.NumEntry()) / data.NumRow() / num_feature;
+    if (density < dense_threshold_) return;
+    dense_.Init(data, num_feature);
+    data.Clear(); buffer_.Close();
+    fmat_ = &dense_;
+    if (!silent) {
+      printf("density %.2f, use dense storage\n", density);
+    }
+  }
+  /*! \brief memory mapped binary buffer that data may refer to */
+  io::BufferReader buffer_;
+  /*! \brief external memory feature matrix */
+  io::FMatrixPage page_;
+  /*! \brief dense feature matrix */
+  io::FMatrixD dense_;
+  /*! \brief parameters of external memory */
+  io::FMatrixPage::Param page_param_;
+  /*! \brief feature matrix in use */
+  const IFMatrix *fmat_;
+  /*! \brief minimum density to store data densely */
+  float dense_threshold_;
+  /*! \brief whether to write block compressed binary buffer */
+  int buffer_compress_;
+  /*! \brief whether to read the roots of the instances from the group file */
+  int use_group_;
+  /*! \brief number of bytes of text source data is loaded from, 0 if unknown */
+  size_t src_size_;
+  /*! \brief fingerprint of the text source */
+  uint64_t src_hash_;
 };
 }  // namespace learner
 }  // namespace xgboost
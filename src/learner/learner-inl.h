@@ -47,14 +47,16 @@ class BoostLearner {
                       const std::vector<std::string> &evname) {
     this->train_ = train;
     this->evals_ = evals;
+    // the cache of the boosters is built on the training data
+    base_gbm.ClearCache();
     this->evname_ = evname; 
     // estimate feature bound
-    int num_feature = (int)(train->data.NumCol());
+    int num_feature = (int)(train->num_feature);
     // assign buffer index
     unsigned buffer_size = static_cast<unsigned>(train->Size());
     for (size_t i = 0; i < evals.size(); ++i) {
       buffer_size += static_cast<unsigned>(evals[i]->Size());
-      num_feature = std::max(num_feature, (int)(evals[i]->data.NumCol()));
+      num_feature = std::max(num_feature, (int)(evals[i]->num_feature));
     }
     
     char str_temp[25];
@@ -129,8 +131,7 @@ class BoostLearner {
   inline void UpdateOneIter(int iter) {
     this->PredictBuffer(preds_, *train_, 0);
     this->GetGradient(preds_, train_->labels, grad_, hess_);
-    std::vector<unsigned> root_index;
-    base_gbm.DoBoost(grad_, hess_, train_->data, root_index);                
+    base_gbm.DoBoost(grad_, hess_, train_->fmat(), train_->root_index);                
   }  
   /*! 
    * \brief evaluate the model for specific iteration
@@ -152,24 +153,24 @@ class BoostLearner {
   /*! \brief get prediction, without buffering */
   inline void Predict(std::vector<float> &preds, const DMatrix &data) {
     preds.resize(data.Size());
+    base_gbm.PredictBatch(data.fmat(), data.root_index, -1, &preds);
 
     const unsigned ndata = static_cast<unsigned>(data.Size());
     #pragma omp parallel for schedule(static)
     for (unsigned j = 0; j < ndata; ++j) {
-      preds[j] = mparam.PredTransform
-            (mparam.base_score + base_gbm.Predict(data.data, j, -1));
+      preds[j] = mparam.PredTransform(mparam.base_score + preds[j]);
     }
   }  
  protected:
   /*! \brief get the transformed predictions, given data */
   inline void PredictBuffer(std::vector<float> &preds, const DMatrix &data, unsigned buffer_offset) {
     preds.resize(data.Size());
+    base_gbm.PredictBatch(data.fmat(), data.root_index, static_cast<int>(buffer_offset), &preds);
 
     const unsigned ndata = static_cast<unsigned>(data.Size());
     #pragma omp parallel for schedule(static)
     for (unsigned j = 0; j < ndata; ++j) {                
-      preds[j] = mparam.PredTransform(mparam.base_score 
-          + base_gbm.Predict(data.data, j, buffer_offset + j));
+      preds[j] = mparam.PredTransform(mparam.base_score + preds[j]);
     }
   }  
   /*! \brief get the first order and second order gradient, given the transformed predictions and labels */
@@ -0,0 +1,332 @@
+#ifndef XGBOOST_TREE_BASE_TREEMAKER_HPP_
+#define XGBOOST_TREE_BASE_TREEMAKER_HPP_
+/*!
+ * \file base_treemaker.hpp
+ * \brief common parts of the tree makers: node statistics, expand queue,
+ *        row positions and pruning, the makers differ in how splits are found
+ */
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include "tree_model.h"
+#include "../data.h"
+#include "../utils/omp.h"
+#include "../utils/fmap.h"
+#include "../utils/timer.h"
+#include "../utils/random.h"
+
+namespace xgboost {
+namespace gbm {
+/*! \brief base class of tree makers that grow a RegTree level by level */
+class BaseTreeMaker {
+ protected:
+  // training parameter
+  const TreeParamTrain &param;
+  // feature constrain
+  const utils::FeatConstrain &constrain;
+  // parameters, reference
+  RegTree &tree;
+  std::vector<float> &grad;
+  std::vector<float> &hess;
+  const IFMatrix &smat;
+  const std::vector<unsigned> &group_id;
+  // whether to print the timings
+  int silent;
+ public:
+  BaseTreeMaker(const TreeParamTrain &pparam,
+                const utils::FeatConstrain &pconstrain,
+                RegTree &ptree,
+                std::vector<float> &pgrad,
+                std::vector<float> &phess,
+                const IFMatrix &psmat,
+                const std::vector<unsigned> &pgroup_id,
+                int psilent):
+      param(pparam), constrain(pconstrain), tree(ptree), grad(pgrad), hess(phess),
+      smat(psmat), group_id(pgroup_id), silent(psilent), rnd_level(NULL) {
+    utils::Assert(grad.size() == smat.NumRow() && hess.size() == smat.NumRow(),
+                  "TreeMaker: number of gradient must equal number of rows");
+  }
+
+ protected:
+  /*! \brief statistics of a node in training */
+  struct NodeEntry {
+    /*! \brief statistics of the instances in the node */
+    GradStats stats;
+    /*! \brief loss of the node without split */
+    double root_gain;
+    /*! \brief weight of the node */
+    float weight;
+    /*! \brief best split of the node */
+    SplitEntry best;
+  };
+  /*! \brief initialize the row positions, the expand queue and the root statistics */
+  inline void InitData(void) {
+    this->InitPosition();
+    const unsigned ndata = static_cast<unsigned>(grad.size());
+    qexpand.clear();
+    for (int i = 0; i < tree.param.num_roots; ++i) {
+      qexpand.push_back(i);
+    }
+    // sum the statistics of the roots
+    const int nroot = tree.param.num_roots;
+    std::vector< std::vector<GradStats> > tstats(omp_get_max_threads(), std::vector<GradStats>(nroot));
+    #pragma omp parallel for schedule(static)
+    for (unsigned i = 0; i < ndata; ++i) {
+      const int nid = position[i];
+      if (nid < 0) continue;
+      tstats[omp_get_thread_num()][nid].Add(grad[i], hess[i]);
+    }
+    snode.resize(tree.param.num_nodes);
+    for (int nid = 0; nid < nroot; ++nid) {
+      snode[nid].stats.Clear();
+      for (size_t tid = 0; tid < tstats.size(); ++tid) {
+        snode[nid].stats.Add(tstats[tid][nid]);
+      }
+      this->InitNodeEntry(nid);
+    }
+  }
+  /*!
+   * \brief initialize a tree of one root grown from the rows given, the positions are not used,
+   *        so the cost only depends on the number of rows given
+   */
+  inline void InitDataRows(const bst_uint *rows, size_t nrows) {
+    utils::Assert(tree.param.num_roots == 1, "TreeMaker: InitDataRows needs a single root");
+    qexpand.assign(1, 0);
+    snode.resize(tree.param.num_nodes);
+    snode[0].stats.Clear();
+    for (size_t i = 0; i < nrows; ++i) {
+      snode[0].stats.Add(grad[rows[i]], hess[rows[i]]);
+    }
+    this->InitNodeEntry(0);
+  }
+  /*! \brief set the root of each row from group_id, and drop the rows not sampled */
+  inline void InitPosition(void) {
+    const unsigned ndata = static_cast<unsigned>(grad.size());
+    position.resize(ndata);
+    if (group_id.size() == 0) {
+      std::fill(position.begin(), position.end(), 0);
+    } else {
+      utils::Assert(group_id.size() == ndata, "TreeMaker: group_id size mismatch");
+      for (unsigned i = 0; i < ndata; ++i) {
+        utils::Check(group_id[i] < static_cast<unsigned>(tree.param.num_roots),
+                     "row %u is in group %u, but there are only %d roots, set bst:num_roots to "
+                     "at least the number of groups", i, group_id[i], tree.param.num_roots);
+        position[i] = static_cast<int>(group_id[i]);
+      }
+    }
+    if (param.subsample < 1.0f) this->SampleRows();
+  }
+  /*!
+   * \brief drop the rows not sampled in this round by setting their position to -1,
+   *        nothing is copied, the makers skip the rows with negative position;
+   *        goss keeps the goss_top_rate rows with the largest |grad|, draws subsample - goss_top_rate
+   *        of all rows from the others and scales up their gradient to keep the sums unbiased,
+   *        the gradients are changed in place, which DoBoost allows
+   */
+  inline void SampleRows(void) {
+    const size_t ndata = position.size();
+    size_t nkeep = 0;
+    if (param.sampling_method == 0) {
+      for (size_t i = 0; i < ndata; ++i) {
+        if (position[i] < 0) continue;
+        if (random::SampleBinary(param.subsample)) {
+          ++nkeep;
+        } else {
+          position[i] = -1;
+        }
+      }
+    } else {
+      utils::Check(param.goss_top_rate > 0.0f && param.goss_top_rate < param.subsample,
+                   "goss needs 0 < goss_top_rate < subsample");
+      std::vector<float> absg;
+      for (size_t i = 0; i < ndata; ++i) {
+        if (position[i] >= 0) absg.push_back(std::fabs(grad[i]));
+      }
+      const size_t ntop = static_cast<size_t>(absg.size() * param.goss_top_rate);
+      // with too few rows for one top row, the top is empty and all the rows are drawn
+      float bound = std::numeric_limits<float>::infinity();
+      size_t nties = 0;
+      if (ntop != 0) {
+        std::nth_element(absg.begin(), absg.begin() + (ntop - 1), absg.end(), std::greater<float>());
+        bound = absg[ntop - 1];
+        size_t nabove = 0;
+        for (size_t i = 0; i < ntop; ++i) {
+          if (absg[i] > bound) ++nabove;
+        }
+        // rows tied with the bound fill the top slots in row order, the top is exactly ntop rows
+        nties = ntop - nabove;
+      }
+      const double other_rate = param.subsample - param.goss_top_rate;
+      const double prob = other_rate / (1.0 - param.goss_top_rate);
+      const float scale = static_cast<float>((1.0 - param.goss_top_rate) / other_rate);
+      for (size_t i = 0; i < ndata; ++i) {
+        if (position[i] < 0) continue;
+        const float g = std::fabs(grad[i]);
+        if (g > bound || (g == bound && nties != 0)) {
+          if (g == bound) --nties;
+          ++nkeep;
+        } else if (random::SampleBinary(prob)) {
+          grad[i] *= scale; hess[i] *= scale;
+          ++nkeep;
+        } else {
+          position[i] = -1;
+        }
+      }
+    }
+    if (!silent) {
+      printf("sampled %lu of %lu rows\n", static_cast<unsigned long>(nkeep), static_cast<unsigned long>(ndata));
+    }
+  }
+  /*!
+   * \brief draw the features of this tree, the ones not banned subsampled by colsample_bytree
+   * \param ncol number of features
+   */
+  inline void InitFeatures(unsigned ncol) {
+    feat_tree.clear();
+    for (unsigned fid = 0; fid < ncol; ++fid) {
+      if (constrain.NotBanned(fid)) feat_tree.push_back(fid);
+    }
+    SampleFeatures(&feat_tree, param.colsample_bytree);
+    feat_level.clear();
+  }
+  /*!
+   * \brief features searched for the nodes at depth, the features of the tree
+   *        subsampled by colsample_bylevel, drawn once for each depth,
+   *        from rnd_level if it is set, otherwise from the shared generator
+   */
+  inline const std::vector<unsigned> &LevelFeatures(int depth) {
+    if (param.colsample_bylevel >= 1.0f) return feat_tree;
+    while (feat_level.size() <= static_cast<size_t>(depth)) {
+      feat_level.push_back(feat_tree);
+      SampleFeatures(&feat_level.back(), param.colsample_bylevel, rnd_level);
+    }
+    return feat_level[depth];
+  }
+  /*!
+   * \brief keep a random fraction of the features, at least one, in increasing order
+   * \param rnd generator to draw from, NULL for the shared one
+   */
+  inline static void SampleFeatures(std::vector<unsigned> *feats, float rate,
+                                    random::Random *rnd = NULL) {
+    if (rate >= 1.0f || feats->size() == 0) return;
+    if (rnd != NULL) {
+      rnd->Shuffle(*feats);
+    } else {
+      random::Shuffle(*feats);
+    }
+    const size_t n = static_cast<size_t>(feats->size() * rate + 0.5f);
+    feats->resize(std::max(n, static_cast<size_t>(1)));
+    std::sort(feats->begin(), feats->end());
+  }
+  /*! \brief calculate the gain and weight of a node whose statistics are set */
+  inline void InitNodeEntry(int nid) {
+    NodeEntry &e = snode[nid];
+    e.root_gain = e.stats.CalcGain(param);
+    e.weight = static_cast<float>(e.stats.CalcWeight(param));
+    e.best = SplitEntry();
+    RTreeNodeStat &s = tree.stat(nid);
+    s.loss_chg = 0.0f;
+    s.sum_hess = static_cast<float>(e.stats.sum_hess);
+    s.base_weight = e.weight;
+    s.leaf_child_cnt = 0;
+  }
+  /*!
+   * \brief split the node with its best split if it is good enough, otherwise make it a leaf
+   * \return whether the node is split
+   */
+  inline bool ApplySplit(int nid, int depth) {
+    const SplitEntry best = snode[nid].best;
+    if (best.loss_chg > rt_eps && !param.CannotSplit(snode[nid].stats.sum_hess, depth)) {
+      tree.AddChilds(nid);
+      tree[nid].set_split(best.split_index(), best.split_value, best.default_left());
+      tree.stat(nid).loss_chg = best.loss_chg;
+      const int cleft = tree[nid].cleft(), cright = tree[nid].cright();
+      snode.resize(tree.param.num_nodes);
+      snode[cleft].stats = best.left_sum;
+      snode[cright].stats.SetSubstract(snode[nid].stats, best.left_sum);
+      this->InitNodeEntry(cleft);
+      this->InitNodeEntry(cright);
+      return true;
+    } else {
+      tree[nid].set_leaf(snode[nid].weight * param.learning_rate);
+      return false;
+    }
+  }
+  /*!
+   * \brief move the rows of split nodes to the default child,
+   *        and mark the rows of the new leaves as finished by setting position to ~nid
+   */
+  inline void ResetPosition(void) {
+    const unsigned ndata = static_cast<unsigned>(position.size());
+    #pragma omp parallel for schedule(static)
+    for (unsigned i = 0; i < ndata; ++i) {
+      const int nid = position[i];
+      if (nid < 0) continue;
+      if (tree[nid].is_leaf()) {
+        position[i] = ~nid;
+      } else {
+        position[i] = tree[nid].cdefault();
+      }
+    }
+  }
+  /*! \brief the children of split nodes form the next level */
+  inline void UpdateQueueExpand(void) {
+    std::vector<int> newnodes;
+    for (size_t i = 0; i < qexpand.size(); ++i) {
+      const int nid = qexpand[i];
+      if (!tree[nid].is_leaf()) {
+        newnodes.push_back(tree[nid].cleft());
+        newnodes.push_back(tree[nid].cright());
+      }
+    }
+    qexpand = newnodes;
+  }
+  /*!
+   * \brief turn the nodes left in the queue into leaves, and prune the tree
+   * \param num_pruned output number of nodes pruned
+   * \return maximum depth of the tree
+   */
+  inline int Finish(int &num_pruned) {
+    for (size_t i = 0; i < qexpand.size(); ++i) {
+      const int nid = qexpand[i];
+      tree[nid].set_leaf(snode[nid].weight * param.learning_rate);
+    }
+    qexpand.clear();
+    num_pruned = 0;
+    for (int nid = 0; nid < tree.param.num_nodes; ++nid) {
+      if (tree[nid].is_leaf()) this->TryPruneLeaf(nid, num_pruned);
+    }
+    return tree.MaxDepth();
+  }
+  /*! \brief prune the split of parent if both children are leaves and the gain is too small */
+  inline void TryPruneLeaf(int nid, int &num_pruned) {
+    if (tree[nid].is_root()) return;
+    const int pid = tree[nid].parent();
+    RTreeNodeStat &s = tree.stat(pid);
+    ++s.leaf_child_cnt;
+    if (s.leaf_child_cnt >= 2 && s.loss_chg < param.min_split_loss) {
+      tree.ChangeToLeaf(pid, s.base_weight * param.learning_rate);
+      num_pruned += 2;
+      this->TryPruneLeaf(pid, num_pruned);
+    }
+  }
+
+ protected:
+  /*! \brief node of each row, negative if the row no longer takes part: ~nid for a finished leaf */
+  std::vector<int> position;
+  /*! \brief nodes to be expanded in current level */
+  std::vector<int> qexpand;
+  /*! \brief statistics of each node */
+  std::vector<NodeEntry> snode;
+  /*! \brief features of this tree */
+  std::vector<unsigned> feat_tree;
+  /*! \brief features of each depth, used when colsample_bylevel is set */
+  std::vector< std::vector<unsigned> > feat_level;
+  /*! \brief generator of feat_level, NULL for the shared one; set for trees grown concurrently */
+  random::Random *rnd_level;
+};
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_TREE_BASE_TREEMAKER_HPP_
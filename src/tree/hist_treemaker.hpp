@@ -0,0 +1,652 @@
+#ifndef XGBOOST_TREE_HIST_TREEMAKER_HPP_
+#define XGBOOST_TREE_HIST_TREEMAKER_HPP_
+/*!
+ * \file hist_treemaker.hpp
+ * \brief histogram based tree maker, the features are quantized once per training run,
+ *        at weighted quantiles sketched from the rows with the hessian of the first round,
+ *        the tree is grown level by level, the gradient statistics of the rows in each node
+ *        are summed into per bin histograms, and split points are only searched at bin boundaries;
+ *        of two siblings only the smaller one is built, the other one is its parent minus it
+ *
+ *        the node of each row is either tracked by the position array, so each level scans all rows,
+ *        or the rows of each node are kept contiguous and partitioned after every split,
+ *        so that only the rows of the nodes being built are visited, in increasing order
+ *
+ *        with grow_policy=lossguide the tree is grown best first instead: the candidate leaves wait
+ *        in a priority queue ordered by the loss change of their best split, the best one is split
+ *        and its children evaluated, until max_leaves is reached; this always uses the row sets
+ *
+ *        the roots of a forest given by root_index are independent, when there are at least as many
+ *        roots as threads, each is grown as a task of its own from the rows of the root, the tasks are
+ *        scheduled dynamically over the threads; with fewer roots they are grown together level by level,
+ *        since a task only uses one thread
+ */
+#include <queue>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "tree_model.h"
+#include "hist_util.h"
+#include "row_set.h"
+#include "base_treemaker.hpp"
+#include "../data.h"
+#include "../utils/omp.h"
+#include "../utils/timer.h"
+
+namespace xgboost {
+namespace gbm {
+/*! \brief state of the histogram tree maker kept by the model across rounds */
+struct HistCache : public IBoosterCache {
+  /*! \brief the quantized training matrix, built in the first round and reused by the later ones */
+  HistIndexMatrix gmat;
+  /*! \brief the histogram pool, shared by the trees of all rounds */
+  HistPool pool;
+  /*! \brief histogram pool of each thread growing the roots of a forest, see HistTreeMaker::BoostRoots */
+  std::vector<HistPool*> tpools;
+  virtual ~HistCache(void) {
+    for (size_t i = 0; i < tpools.size(); ++i) {
+      delete tpools[i];
+    }
+  }
+  /*! \brief get the cache held by slot, it is created when the slot is empty */
+  inline static HistCache &Get(IBoosterCache **slot) {
+    if (*slot == NULL) *slot = new HistCache();
+    HistCache *cache = dynamic_cast<HistCache*>(*slot);
+    utils::Assert(cache != NULL, "HistCache: the slot holds the cache of another booster");
+    return *cache;
+  }
+};
+/*! \brief tree maker that finds splits from gradient histograms, optionally on partitioned row sets */
+class HistTreeMaker : public BaseTreeMaker {
+ public:
+  HistTreeMaker(const TreeParamTrain &pparam,
+                const utils::FeatConstrain &pconstrain,
+                RegTree &ptree,
+                std::vector<float> &pgrad,
+                std::vector<float> &phess,
+                const IFMatrix &psmat,
+                const std::vector<unsigned> &pgroup_id,
+                HistCache &pcache,
+                bool prow_partition = false,
+                int psilent = 1):
+      BaseTreeMaker(pparam, pconstrain, ptree, pgrad, phess, psmat, pgroup_id, psilent),
+      row_partition(prow_partition || pparam.grow_policy != 0), gmat(pcache.gmat), pool(pcache.pool),
+      tpools(pcache.tpools), hist_mem(static_cast<size_t>(pparam.max_hist_mem) << 20) {
+  }
+  /*!
+   * \brief grow the tree with the gradient statistics
+   * \param num_pruned output number of nodes pruned after growing
+   * \return maximum depth of the tree
+   */
+  inline int do_boost(int &num_pruned) {
+    const double eps = param.sketch_eps > 0.0f ? param.sketch_eps : 0.5 / param.max_bin;
+    if (!gmat.Match(smat, static_cast<unsigned>(param.max_bin), eps)) {
+      const double tstart = utils::GetTime();
+      gmat.Init(smat, hess, static_cast<unsigned>(param.max_bin), eps);
+      if (!silent) {
+        printf("quantized %lu entries into %u bins, %d bytes per entry, %.1f MB, %.3f sec\n",
+               static_cast<unsigned long>(gmat.row_ptr.back()), gmat.cut.NumBin(), gmat.EntryBytes(),
+               gmat.MemCost() / 1048576.0, utils::GetTime() - tstart);
+      }
+    }
+    if (tree.param.num_roots > 1 && group_id.size() != 0 &&
+        tree.param.num_roots >= omp_get_max_threads()) {
+      return this->BoostRoots(num_pruned);
+    }
+    this->InitData();
+    this->InitFeatures(static_cast<unsigned>(gmat.cut.row_ptr.size() - 1));
+    if (row_partition) row_set.Init(position, tree.param.num_nodes);
+    return this->Grow(num_pruned);
+  }
+
+ private:
+  /*! \brief maker of the tree of one root of a forest, shares the quantized matrix and features of parent */
+  HistTreeMaker(const HistTreeMaker &parent, RegTree &ptree, HistPool &ppool, size_t phist_mem):
+      BaseTreeMaker(parent.param, parent.constrain, ptree, parent.grad, parent.hess,
+                    parent.smat, parent.group_id, 1),
+      row_partition(true), gmat(parent.gmat), pool(ppool), tpools(parent.tpools), hist_mem(phist_mem) {
+    feat_tree = parent.feat_tree;
+  }
+  /*!
+   * \brief grow the roots of a forest concurrently, one task for each root, scheduled dynamically;
+   *        a task grows its root as the single root of a tree of its own, from the rows of the root,
+   *        with the histogram pool of the thread kept in the cache, so the pools are recycled across
+   *        rounds, and max_hist_mem is split among them; the trees are then copied under the roots;
+   *        max_leaves applies to each root; the nested parallel regions of a task run in one thread,
+   *        so this is only used when the roots keep all the threads busy;
+   *        each root draws its colsample_bylevel features from a generator of its own, seeded in
+   *        order of the roots before the tasks start, so the model does not depend on the schedule
+   */
+  inline int BoostRoots(int &num_pruned) {
+    const double tstart = utils::GetTime();
+    const int nroot = tree.param.num_roots;
+    this->InitPosition();
+    this->InitFeatures(static_cast<unsigned>(gmat.cut.row_ptr.size() - 1));
+    row_set.Init(position, nroot);
+    const int nthread = omp_get_max_threads();
+    while (tpools.size() < static_cast<size_t>(nthread)) {
+      tpools.push_back(new HistPool());
+    }
+    std::vector<RegTree> subtrees(nroot);
+    std::vector<int> pruned(nroot, 0);
+    std::vector<random::Random> rnds(nroot);
+    if (param.colsample_bylevel < 1.0f) {
+      for (int rid = 0; rid < nroot; ++rid) {
+        rnds[rid] = random::Random(static_cast<uint32_t>(random::NextDouble() * 4294967296.0));
+      }
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int rid = 0; rid < nroot; ++rid) {
+      RegTree &sub = subtrees[rid];
+      sub.param = tree.param;
+      sub.param.num_roots = 1;
+      sub.InitModel();
+      HistTreeMaker maker(*this, sub, *tpools[omp_get_thread_num()], hist_mem / nthread);
+      maker.rnd_level = &rnds[rid];
+      maker.InitDataRows(row_set.Rows(rid), row_set.Size(rid));
+      maker.row_set.Init(row_set.Rows(rid), row_set.Size(rid));
+      maker.Grow(pruned[rid]);
+    }
+    num_pruned = 0;
+    for (int rid = 0; rid < nroot; ++rid) {
+      tree.CopySubtree(rid, subtrees[rid], 0);
+      num_pruned += pruned[rid];
+    }
+    if (!silent) {
+      printf("grew %d roots in %d threads, %.3f sec\n", nroot, nthread, utils::GetTime() - tstart);
+    }
+    return tree.MaxDepth();
+  }
+  /*! \brief grow the tree from the roots in the queue, the rows are set up */
+  inline int Grow(int &num_pruned) {
+    pool.Init(gmat.cut.NumBin(), hist_mem);
+    node2hist.resize(tree.param.num_nodes);
+    std::fill(node2hist.begin(), node2hist.end(), -1);
+    if (param.grow_policy != 0) {
+      this->ExpandLossGuide();
+      return this->Finish(num_pruned);
+    }
+    for (int depth = 0; depth < param.max_depth && qexpand.size() != 0; ++depth) {
+      const double tstart = utils::GetTime();
+      time_hist = 0.0; num_built = 0; num_derived = 0;
+      this->ExpandLevel(depth);
+      const double tsplit = utils::GetTime();
+      if (row_partition) {
+        this->PartitionRows(qexpand);
+      } else {
+        this->UpdatePosition();
+      }
+      this->UpdateQueueExpand();
+      if (!silent) {
+        printf("level %d: build hist %.3f sec (%lu built, %lu subtracted), find split %.3f sec, "
+               "update position %.3f sec, %lu nodes to expand\n",
+               depth, time_hist, static_cast<unsigned long>(num_built), static_cast<unsigned long>(num_derived),
+               tsplit - tstart - time_hist, utils::GetTime() - tsplit,
+               static_cast<unsigned long>(qexpand.size()));
+      }
+    }
+    return this->Finish(num_pruned);
+  }
+  /*! \brief a candidate leaf of lossguide growth */
+  struct ExpandEntry {
+    int nid, depth;
+    float loss_chg;
+    ExpandEntry(int nid, int depth, float loss_chg) : nid(nid), depth(depth), loss_chg(loss_chg) {}
+    // the largest loss change is on top, ties go to the smaller node id so the tree is deterministic
+    inline bool operator<(const ExpandEntry &b) const {
+      if (loss_chg != b.loss_chg) return loss_chg < b.loss_chg;
+      return nid > b.nid;
+    }
+  };
+  /*! \brief grow the tree best first, until no candidate is left or the tree has max_leaves leaves */
+  inline void ExpandLossGuide(void) {
+    const double tstart = utils::GetTime();
+    time_hist = 0.0; num_built = 0; num_derived = 0;
+    double time_partition = 0.0;
+    std::priority_queue<ExpandEntry> qcand;
+    for (int nid = 0; nid < tree.param.num_roots; ++nid) {
+      this->EvaluateNodes(&nid, 1, 0, &qcand);
+    }
+    qexpand.clear();
+    int num_leaves = tree.param.num_roots;
+    while (!qcand.empty()) {
+      const ExpandEntry e = qcand.top();
+      qcand.pop();
+      if (param.max_leaves > 0 && num_leaves >= param.max_leaves) {
+        this->SetLeaf(e.nid); continue;
+      }
+      utils::Assert(this->ApplySplit(e.nid, e.depth), "HistTreeMaker: candidate can not be split");
+      ++num_leaves;
+      node2hist.resize(tree.param.num_nodes, -1);
+      const double tpart = utils::GetTime();
+      this->PartitionRows(std::vector<int>(1, e.nid));
+      time_partition += utils::GetTime() - tpart;
+      const int childs[2] = {tree[e.nid].cleft(), tree[e.nid].cright()};
+      this->EvaluateNodes(childs, 2, e.depth + 1, &qcand);
+    }
+    if (!silent) {
+      printf("lossguide: %d leaves, build hist %.3f sec (%lu built, %lu subtracted), find split %.3f sec, "
+             "partition %.3f sec\n",
+             num_leaves, time_hist, static_cast<unsigned long>(num_built), static_cast<unsigned long>(num_derived),
+             utils::GetTime() - tstart - time_hist - time_partition, time_partition);
+    }
+  }
+  /*!
+   * \brief get the histograms of a root or a pair of new siblings and find their best splits,
+   *        the nodes that can be split become candidates, the others become leaves
+   */
+  inline void EvaluateNodes(const int *nodes, size_t n, int depth, std::priority_queue<ExpandEntry> *qcand) {
+    build.clear(); derive.clear();
+    if (!this->Reserve(nodes, n)) {
+      this->FreeHistExcept(n == 2 ? tree[nodes[0]].parent() : -1);
+      utils::Assert(this->Reserve(nodes, n), "HistTreeMaker: histogram pool too small");
+    }
+    this->BuildBatch();
+    const std::vector<int> batch(nodes, nodes + n);
+    this->FindSplit(batch, depth);
+    for (size_t i = 0; i < n; ++i) {
+      const int nid = nodes[i];
+      const NodeEntry &e = snode[nid];
+      if (e.best.loss_chg > rt_eps && !param.CannotSplit(e.stats.sum_hess, depth)) {
+        qcand->push(ExpandEntry(nid, depth, e.best.loss_chg));
+      } else {
+        this->SetLeaf(nid);
+      }
+    }
+  }
+  /*! \brief make a node a leaf and give back its histogram, which FreeHistExcept may have taken already */
+  inline void SetLeaf(int nid) {
+    tree[nid].set_leaf(snode[nid].weight * param.learning_rate);
+    if (node2hist[nid] >= 0) {
+      pool.Free(node2hist[nid]); node2hist[nid] = -1;
+    }
+  }
+  /*! \brief give up the histograms kept for later, except the one of node keep */
+  inline void FreeHistExcept(int keep) {
+    for (size_t nid = 0; nid < node2hist.size(); ++nid) {
+      if (node2hist[nid] >= 0 && static_cast<int>(nid) != keep) {
+        pool.Free(node2hist[nid]); node2hist[nid] = -1;
+      }
+    }
+  }
+  /*!
+   * \brief find the splits of all nodes in the queue, the nodes are processed in batches
+   *        whose histograms fit in the pool, usually the whole level is one batch;
+   *        a batch leaves free in the pool a histogram of each other thread for each node
+   *        to be built, see BuildHist
+   */
+  inline void ExpandLevel(int depth) {
+    const size_t nteam = static_cast<size_t>(NumTeam());
+    std::vector<int> batch;
+    build.clear(); derive.clear();
+    for (size_t i = 0; i < qexpand.size();) {
+      // siblings are next to each other in the queue, a root is on its own
+      const size_t n = tree[qexpand[i]].is_root() ? 1 : 2;
+      const bool fit = batch.size() == 0 || pool.NumFree() >= n * nteam + build.size() * (nteam - 1);
+      if (fit && this->Reserve(&qexpand[i], n)) {
+        batch.insert(batch.end(), qexpand.begin() + i, qexpand.begin() + i + n);
+        i += n; continue;
+      }
+      if (batch.size() != 0) {
+        this->ProcessBatch(batch, depth);
+        batch.clear(); continue;
+      }
+      // the pool is held by histograms kept for later, give them up
+      this->FreeHistExcept(n == 2 ? tree[qexpand[i]].parent() : -1);
+      utils::Assert(this->Reserve(&qexpand[i], n), "HistTreeMaker: histogram pool too small");
+      batch.insert(batch.end(), qexpand.begin() + i, qexpand.begin() + i + n);
+      i += n;
+    }
+    if (batch.size() != 0) this->ProcessBatch(batch, depth);
+  }
+  /*!
+   * \brief get the histograms of a root or a pair of siblings, when the parent histogram is kept
+   *        the larger sibling takes it over and the smaller one is built, otherwise both are built
+   * \return false if the pool can not provide the histograms
+   */
+  inline bool Reserve(const int *nodes, size_t n) {
+    if (n == 2 && node2hist[tree[nodes[0]].parent()] >= 0) {
+      const int pid = tree[nodes[0]].parent();
+      const bool left_small = snode[nodes[0]].stats.sum_hess <= snode[nodes[1]].stats.sum_hess;
+      const int small = left_small ? nodes[0] : nodes[1];
+      const int large = left_small ? nodes[1] : nodes[0];
+      const int id = pool.Alloc();
+      if (id < 0) return false;
+      node2hist[small] = id;
+      node2hist[large] = node2hist[pid];
+      node2hist[pid] = -1;
+      build.push_back(small);
+      derive.push_back(std::make_pair(large, small));
+      return true;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      const int id = pool.Alloc();
+      if (id < 0) {
+        for (size_t j = 0; j < i; ++j) {
+          pool.Free(node2hist[nodes[j]]); node2hist[nodes[j]] = -1;
+        }
+        return false;
+      }
+      node2hist[nodes[i]] = id;
+    }
+    build.insert(build.end(), nodes, nodes + n);
+    return true;
+  }
+  /*!
+   * \brief build and subtract the histograms of a batch, find the splits,
+   *        the histograms of the split nodes are kept for their children
+   */
+  inline void ProcessBatch(const std::vector<int> &batch, int depth) {
+    this->BuildBatch();
+    this->FindSplit(batch, depth);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      this->ApplySplit(batch[i], depth);
+    }
+    node2hist.resize(tree.param.num_nodes, -1);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const int nid = batch[i];
+      if (tree[nid].is_leaf()) {
+        pool.Free(node2hist[nid]); node2hist[nid] = -1;
+      }
+    }
+  }
+  /*! \brief build the histograms in the build list, and subtract the ones in the derive list */
+  inline void BuildBatch(void) {
+    const double tstart = utils::GetTime();
+    this->BuildHist();
+    const unsigned nbin = gmat.cut.NumBin();
+    for (size_t i = 0; i < derive.size(); ++i) {
+      GradStats *h = pool[node2hist[derive[i].first]];
+      const GradStats *hsmall = pool[node2hist[derive[i].second]];
+      #pragma omp parallel for schedule(static)
+      for (unsigned b = 0; b < nbin; ++b) {
+        h[b].SetSubstract(h[b], hsmall[b]);
+      }
+    }
+    time_hist += utils::GetTime() - tstart;
+    num_built += build.size(); num_derived += derive.size();
+    build.clear(); derive.clear();
+  }
+  /*!
+   * \brief build the histograms of the nodes in build list; each thread adds up its rows in
+   *        histograms of its own, which are then summed into the ones of the nodes; the first
+   *        thread adds up right in the histograms of the nodes, the other threads take theirs
+   *        from the pool, so they are within max_hist_mem too: the list is built in chunks of
+   *        as many nodes as the free histograms allow, with fewer threads if they do not allow one
+   */
+  inline void BuildHist(void) {
+    const unsigned nbin = gmat.cut.NumBin();
+    const size_t nwork = build.size();
+    if (nwork == 0) return;
+    const size_t nteam = static_cast<size_t>(NumTeam());
+    std::vector<int> extra;
+    while (extra.size() < nwork * (nteam - 1)) {
+      const int id = pool.Alloc();
+      if (id < 0) break;
+      extra.push_back(id);
+    }
+    nchunk = nteam == 1 ? nwork : std::min(nwork, std::max(extra.size() / (nteam - 1), static_cast<size_t>(1)));
+    const int nthread = static_cast<int>(std::min(nteam, 1 + extra.size() / nchunk));
+    node2work.resize(tree.param.num_nodes);
+    std::fill(node2work.begin(), node2work.end(), -1);
+    thist.resize(nthread * nchunk);
+    for (int tid = 1; tid < nthread; ++tid) {
+      for (size_t i = 0; i < nchunk; ++i) {
+        thist[tid * nchunk + i] = pool[extra[(tid - 1) * nchunk + i]];
+      }
+    }
+    for (size_t begin = 0; begin < nwork; begin += nchunk) {
+      const size_t end = std::min(nwork, begin + nchunk);
+      for (size_t i = begin; i < end; ++i) {
+        node2work[build[i]] = static_cast<int>(i - begin);
+        thist[i - begin] = pool[node2hist[build[i]]];
+      }
+      tused.assign(thist.size(), 0);
+      gmat.Visit(BuildHistFn(this, nthread));
+      // sum up the histograms of the other threads, a histogram a thread did not touch is zero
+      const unsigned ntotal = static_cast<unsigned>((end - begin) * nbin);
+      #pragma omp parallel for schedule(static)
+      for (unsigned k = 0; k < ntotal; ++k) {
+        const size_t w = k / nbin;
+        GradStats &h = thist[w][k % nbin];
+        if (tused[w] == 0) h.Clear();
+        for (int tid = 1; tid < nthread; ++tid) {
+          if (tused[tid * nchunk + w] != 0) h.Add(thist[tid * nchunk + w][k % nbin]);
+        }
+      }
+      for (size_t i = begin; i < end; ++i) {
+        node2work[build[i]] = -1;
+      }
+    }
+    for (size_t i = 0; i < extra.size(); ++i) {
+      pool.Free(extra[i]);
+    }
+  }
+  /*! \brief calls BuildHistKernel with the bin index */
+  struct BuildHistFn {
+    HistTreeMaker *self;
+    int nthread;
+    BuildHistFn(HistTreeMaker *self, int nthread) : self(self), nthread(nthread) {}
+    template<typename BinIndex>
+    inline void operator()(const BinIndex &index) const {
+      self->BuildHistKernel(index, nthread);
+    }
+  };
+  /*! \brief build the histograms of the nodes of the chunk in nthread threads */
+  template<typename BinIndex>
+  inline void BuildHistKernel(const BinIndex &index, int nthread) {
+    if (!row_partition) {
+      const unsigned ndata = static_cast<unsigned>(position.size());
+      #pragma omp parallel for schedule(static) num_threads(nthread)
+      for (unsigned i = 0; i < ndata; ++i) {
+        const int nid = position[i];
+        if (nid < 0 || node2work[nid] < 0) continue;
+        this->AddRow(index, i, this->ThreadHist(node2work[nid]));
+      }
+    } else {
+      // blocks of the row sets of the nodes to be built
+      std::vector< std::pair<size_t, size_t> > blocks;
+      for (size_t i = 0; i < build.size(); ++i) {
+        if (node2work[build[i]] < 0) continue;
+        const size_t nrow = row_set.Size(build[i]);
+        for (size_t s = 0; s < nrow; s += kRowBlockSize) {
+          blocks.push_back(std::make_pair(i, s));
+        }
+      }
+      const unsigned nblock = static_cast<unsigned>(blocks.size());
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(nthread)
+      for (unsigned k = 0; k < nblock; ++k) {
+        const int nid = build[blocks[k].first];
+        const bst_uint *rows = row_set.Rows(nid);
+        const size_t end = std::min(row_set.Size(nid), blocks[k].second + kRowBlockSize);
+        GradStats *hnode = this->ThreadHist(node2work[nid]);
+        for (size_t j = blocks[k].second; j < end; ++j) {
+          this->AddRow(index, rows[j], hnode);
+        }
+      }
+    }
+  }
+  /*! \brief histogram of the calling thread for the w-th node of the chunk, zeroed on first use */
+  inline GradStats *ThreadHist(int w) {
+    const size_t k = omp_get_thread_num() * nchunk + w;
+    if (tused[k] == 0) {
+      std::fill(thist[k], thist[k] + gmat.cut.NumBin(), GradStats());
+      tused[k] = 1;
+    }
+    return thist[k];
+  }
+  /*! \return number of threads of a parallel region here, a task of a forest runs in one thread */
+  inline static int NumTeam(void) {
+    return omp_in_parallel() ? 1 : omp_get_max_threads();
+  }
+  /*! \brief add the statistics of a row to the histogram of its node */
+  template<typename BinIndex>
+  inline void AddRow(const BinIndex &index, bst_uint ridx, GradStats *hnode) const {
+    const double g = grad[ridx], hs = hess[ridx];
+    const size_t rbegin = gmat.row_ptr[ridx], rend = gmat.row_ptr[ridx + 1];
+    for (size_t j = rbegin; j < rend; ++j) {
+      hnode[index.Global(j, rbegin)].Add(g, hs);
+    }
+  }
+  /*!
+   * \brief enumerate the bin boundaries of one feature of a node, the missing rows are the node
+   *        minus the sum of the bins; with missing value going right the left child is the bins visited,
+   *        with missing value going left the right child is the bins not visited yet
+   */
+  inline void EnumerateSplit(int nid, unsigned fid, const GradStats *hnode, SplitEntry *best) const {
+    const bool miss_right = param.default_direction != 1;
+    const bool miss_left = param.default_direction != 2;
+    const unsigned beg = gmat.cut.row_ptr[fid], end = gmat.cut.row_ptr[fid + 1];
+    const NodeEntry &e = snode[nid];
+    GradStats present, left, l, r;
+    if (miss_left) {
+      for (unsigned b = beg; b < end; ++b) present.Add(hnode[b]);
+      // only the missing rows go left
+      l.SetSubstract(e.stats, present);
+      if (l.sum_hess >= param.min_child_weight && present.sum_hess >= param.min_child_weight) {
+        const double loss_chg = l.CalcGain(param) + present.CalcGain(param) - e.root_gain;
+        best->Update(static_cast<float>(loss_chg), fid, gmat.cut.min_val[fid], true, l);
+      }
+    }
+    for (unsigned b = beg; b < end; ++b) {
+      left.Add(hnode[b]);
+      if (miss_right && left.sum_hess >= param.min_child_weight) {
+        r.SetSubstract(e.stats, left);
+        if (r.sum_hess >= param.min_child_weight) {
+          const double loss_chg = left.CalcGain(param) + r.CalcGain(param) - e.root_gain;
+          best->Update(static_cast<float>(loss_chg), fid, gmat.cut.cut[b], false, left);
+        }
+      }
+      if (miss_left) {
+        r.SetSubstract(present, left);
+        l.SetSubstract(e.stats, r);
+        if (l.sum_hess >= param.min_child_weight && r.sum_hess >= param.min_child_weight) {
+          const double loss_chg = l.CalcGain(param) + r.CalcGain(param) - e.root_gain;
+          best->Update(static_cast<float>(loss_chg), fid, gmat.cut.cut[b], true, l);
+        }
+      }
+    }
+  }
+  /*! \brief find the best split of each node in the batch at depth from the histograms */
+  inline void FindSplit(const std::vector<int> &batch, int depth) {
+    const size_t nwork = batch.size();
+    std::vector< std::vector<SplitEntry> > tbest(omp_get_max_threads(), std::vector<SplitEntry>(nwork));
+    const std::vector<unsigned> &feats = this->LevelFeatures(depth);
+    const unsigned nfeat = static_cast<unsigned>(feats.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (unsigned k = 0; k < nfeat; ++k) {
+      std::vector<SplitEntry> &best = tbest[omp_get_thread_num()];
+      for (size_t i = 0; i < nwork; ++i) {
+        this->EnumerateSplit(batch[i], feats[k], pool[node2hist[batch[i]]], &best[i]);
+      }
+    }
+    for (size_t i = 0; i < nwork; ++i) {
+      const int nid = batch[i];
+      for (size_t tid = 0; tid < tbest.size(); ++tid) {
+        snode[nid].best.Update(tbest[tid][i]);
+      }
+    }
+  }
+  /*! \brief move each row of the split nodes to its child, using the bin index of the split feature */
+  inline void UpdatePosition(void) {
+    gmat.Visit(UpdatePositionFn(this));
+  }
+  /*! \brief calls UpdatePositionKernel with the bin index */
+  struct UpdatePositionFn {
+    HistTreeMaker *self;
+    explicit UpdatePositionFn(HistTreeMaker *self) : self(self) {}
+    template<typename BinIndex>
+    inline void operator()(const BinIndex &index) const {
+      self->UpdatePositionKernel(index);
+    }
+  };
+  template<typename BinIndex>
+  inline void UpdatePositionKernel(const BinIndex &index) {
+    const GoLeft<BinIndex> goleft(gmat, tree, index);
+    const unsigned ndata = static_cast<unsigned>(position.size());
+    #pragma omp parallel for schedule(static)
+    for (unsigned i = 0; i < ndata; ++i) {
+      const int nid = position[i];
+      if (nid < 0) continue;
+      if (tree[nid].is_leaf()) {
+        position[i] = ~nid;
+      } else {
+        position[i] = goleft(nid, i) ? tree[nid].cleft() : tree[nid].cright();
+      }
+    }
+  }
+  /*! \brief partition the rows of the split nodes among expanded into their children */
+  inline void PartitionRows(const std::vector<int> &expanded) {
+    std::vector<int> nodes, cleft, cright;
+    for (size_t i = 0; i < expanded.size(); ++i) {
+      const int nid = expanded[i];
+      if (tree[nid].is_leaf()) continue;
+      nodes.push_back(nid);
+      cleft.push_back(tree[nid].cleft());
+      cright.push_back(tree[nid].cright());
+    }
+    gmat.Visit(PartitionFn(this, nodes, cleft, cright));
+  }
+  /*! \brief calls RowSetCollection::Partition with the bin index */
+  struct PartitionFn {
+    HistTreeMaker *self;
+    const std::vector<int> &nodes, &cleft, &cright;
+    PartitionFn(HistTreeMaker *self, const std::vector<int> &nodes,
+                const std::vector<int> &cleft, const std::vector<int> &cright)
+        : self(self), nodes(nodes), cleft(cleft), cright(cright) {}
+    template<typename BinIndex>
+    inline void operator()(const BinIndex &index) const {
+      self->row_set.Partition(nodes, cleft, cright, GoLeft<BinIndex>(self->gmat, self->tree, index));
+    }
+  };
+  /*! \brief tells whether a row of a split node goes left, from the bin of the split feature */
+  template<typename BinIndex>
+  struct GoLeft {
+    const HistIndexMatrix &gmat;
+    const RegTree &tree;
+    const BinIndex index;
+    GoLeft(const HistIndexMatrix &gmat, const RegTree &tree, const BinIndex &index)
+        : gmat(gmat), tree(tree), index(index) {}
+    inline bool operator()(int nid, bst_uint ridx) const {
+      const unsigned fid = tree[nid].split_index();
+      const int b = index.Local(fid, gmat.row_ptr[ridx], gmat.row_ptr[ridx + 1]);
+      if (b < 0) return tree[nid].default_left();
+      // every value in bin b is below its cut, so the bin goes left iff the cut is not above the split
+      return gmat.cut.cut[gmat.cut.row_ptr[fid] + b] <= tree[nid].split_cond();
+    }
+  };
+
+ private:
+  /*! \brief whether rows are grouped by node instead of tracked by position */
+  const bool row_partition;
+  /*! \brief rows of each node, used when row_partition is set */
+  RowSetCollection row_set;
+  /*! \brief quantized training matrix */
+  HistIndexMatrix &gmat;
+  /*! \brief pool of node histograms */
+  HistPool &pool;
+  /*! \brief pools of the threads growing the roots of a forest */
+  std::vector<HistPool*> &tpools;
+  /*! \brief memory budget of the pool in bytes */
+  size_t hist_mem;
+  /*! \brief histogram id of each node, -1 if it has none */
+  std::vector<int> node2hist;
+  /*! \brief nodes whose histograms are to be built */
+  std::vector<int> build;
+  /*! \brief pairs of a node whose histogram is its parent minus its sibling, and the sibling */
+  std::vector< std::pair<int, int> > derive;
+  /*! \brief index of each node in the build list, -1 if not in the list */
+  std::vector<int> node2work;
+  /*! \brief number of nodes built at a time by BuildHist */
+  size_t nchunk;
+  /*! \brief histogram of thread tid for the w-th node of the chunk is thist[tid * nchunk + w] */
+  std::vector<GradStats*> thist;
+  /*! \brief whether the thread has touched the histogram, same layout as thist */
+  std::vector<char> tused;
+  /*! \brief statistics of current level, or of the whole tree under lossguide growth */
+  double time_hist;
+  size_t num_built, num_derived;
+};
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_TREE_HIST_TREEMAKER_HPP_
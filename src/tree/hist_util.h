@@ -0,0 +1,507 @@
+#ifndef XGBOOST_TREE_HIST_UTIL_H_
+#define XGBOOST_TREE_HIST_UTIL_H_
+/*!
+ * \file hist_util.h
+ * \brief quantized feature matrix used by the histogram tree maker,
+ *        each feature is cut into at most max_bin bins at weighted quantiles, every present entry is replaced
+ *        by its bin, stored in 1 byte when max_bin <= 256, see HistIndexMatrix
+ */
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <inttypes.h>
+#include "tree_model.h"
+#include "../data.h"
+#include "../utils/utils.h"
+#include "../utils/omp.h"
+#include "../utils/quantile.h"
+
+namespace xgboost {
+namespace gbm {
+/*!
+ * \brief cut points of all features, bin b of feature f holds the values v with
+ *        cut[row_ptr[f] + b - 1] <= v < cut[row_ptr[f] + b]
+ */
+struct HistCutMatrix {
+  /*! \brief start of the cuts of each feature */
+  std::vector<unsigned> row_ptr;
+  /*! \brief upper bound of each bin */
+  std::vector<bst_float> cut;
+  /*! \brief a value below all values of each feature, splitting there sends every present value right */
+  std::vector<bst_float> min_val;
+  /*! \brief number of rows of a sketch chunk */
+  static const size_t kSketchChunk = 64UL << 10;
+  typedef int bst_omp_uint;
+  /*! \return total number of bins */
+  inline unsigned NumBin(void) const {
+    return row_ptr.back();
+  }
+  /*! \brief get the global bin index of a value of feature fid */
+  inline unsigned GetBin(unsigned fid, bst_float fvalue) const {
+    const bst_float *beg = &cut[0] + row_ptr[fid];
+    const bst_float *end = &cut[0] + row_ptr[fid + 1];
+    const bst_float *it = std::upper_bound(beg, end, fvalue);
+    // values above the largest cut only happen for data not seen when building the cuts
+    if (it == end) --it;
+    return static_cast<unsigned>(it - &cut[0]);
+  }
+  /*!
+   * \brief build the cuts from weighted quantile sketches of the rows, no column access is needed,
+   *        the rows are sketched in chunks of kSketchChunk rows, the chunks of a wave are sketched
+   *        in parallel, then the summaries of each feature are merged like a binary counter in order
+   *        of the chunks, so the cuts do not depend on the number of threads;
+   *        each bin holds roughly the same weight, features with at most max_bin distinct values
+   *        get one bin per value
+   * \param fmat feature matrix
+   * \param weight weight of each row, the hessian
+   * \param max_bin maximum number of bins of each feature
+   * \param eps error bound of the sketches, relative to the total weight of a feature
+   */
+  inline void Init(const IFMatrix &fmat, const std::vector<float> &weight, unsigned max_bin, double eps) {
+    const size_t nrow = fmat.NumRow();
+    utils::Assert(weight.size() == nrow, "HistCutMatrix: size of weight must equal number of rows");
+    const size_t limit = utils::WQuantileSketch::LimitSize(nrow, eps);
+    const size_t nchunk = (nrow + kSketchChunk - 1) / kSketchChunk;
+    const size_t nwave = static_cast<size_t>(omp_get_max_threads());
+    // levels[fid][l] is the summary of 2^l chunks, or empty
+    std::vector< std::vector<utils::WQSummary> > levels;
+    std::vector< std::vector<utils::WQSummary> > chunk(nwave);
+    for (size_t wbegin = 0; wbegin < nchunk; wbegin += nwave) {
+      const bst_omp_uint nc = static_cast<bst_omp_uint>(std::min(nwave, nchunk - wbegin));
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (bst_omp_uint c = 0; c < nc; ++c) {
+        const size_t begin = (wbegin + c) * kSketchChunk;
+        const size_t end = std::min(begin + kSketchChunk, nrow);
+        SketchRows(fmat, weight, begin, end, eps, &chunk[c]);
+      }
+      // the number of features is taken from the rows
+      size_t ncol = levels.size();
+      for (bst_omp_uint c = 0; c < nc; ++c) {
+        ncol = std::max(ncol, chunk[c].size());
+      }
+      levels.resize(ncol);
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (bst_omp_uint fid = 0; fid < static_cast<bst_omp_uint>(ncol); ++fid) {
+        for (bst_omp_uint c = 0; c < nc; ++c) {
+          if (static_cast<size_t>(fid) < chunk[c].size()) {
+            CarrySummary(&chunk[c][fid], limit, &levels[fid]);
+          }
+        }
+      }
+    }
+    const unsigned ncol = static_cast<unsigned>(levels.size());
+    std::vector<utils::WQSummary> summary(ncol);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (bst_omp_uint fid = 0; fid < static_cast<bst_omp_uint>(ncol); ++fid) {
+      utils::WQSummary temp;
+      for (size_t l = 0; l < levels[fid].size(); ++l) {
+        if (levels[fid][l].size() == 0) continue;
+        temp.SetCombine(summary[fid], levels[fid][l]);
+        summary[fid].SetPrune(temp, limit);
+      }
+    }
+    std::vector< std::vector<bst_float> > fcuts(ncol);
+    min_val.resize(ncol);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (bst_omp_uint fid = 0; fid < static_cast<bst_omp_uint>(ncol); ++fid) {
+      const utils::WQSummary &s = summary[fid];
+      MakeCuts(s, max_bin, &fcuts[fid]);
+      if (s.size() != 0) {
+        const bst_float first = s.data[0].value;
+        min_val[fid] = first - rt_eps;
+        if (!(min_val[fid] < first)) min_val[fid] = first - std::fabs(first) * rt_eps;
+      } else {
+        min_val[fid] = 0.0f;
+      }
+    }
+    row_ptr.resize(ncol + 1);
+    row_ptr[0] = 0;
+    for (unsigned fid = 0; fid < ncol; ++fid) {
+      row_ptr[fid + 1] = row_ptr[fid] + static_cast<unsigned>(fcuts[fid].size());
+    }
+    cut.resize(row_ptr.back());
+    for (unsigned fid = 0; fid < ncol; ++fid) {
+      std::copy(fcuts[fid].begin(), fcuts[fid].end(), cut.begin() + row_ptr[fid]);
+    }
+  }
+  /*! \brief sketch every feature over rows [begin, end), out is the summary of each feature */
+  inline static void SketchRows(const IFMatrix &fmat, const std::vector<float> &weight,
+                                size_t begin, size_t end, double eps,
+                                std::vector<utils::WQSummary> *out) {
+    std::vector<utils::WQuantileSketch> sketch;
+    for (size_t i = begin; i < end; ++i) {
+      const double w = weight[i];
+      for (IFMatrix::RowIter it = fmat.GetRow(i); it.Next();) {
+        const bst_uint fid = it.findex();
+        if (fid >= sketch.size()) {
+          const size_t nold = sketch.size();
+          sketch.resize(fid + 1);
+          for (size_t k = nold; k < sketch.size(); ++k) sketch[k].Init(end - begin, eps);
+        }
+        sketch[fid].Push(it.fvalue(), w);
+      }
+    }
+    out->resize(sketch.size());
+    for (size_t fid = 0; fid < sketch.size(); ++fid) {
+      sketch[fid].GetSummary(&(*out)[fid]);
+    }
+  }
+  /*! \brief carry the summary of the next chunk into the levels of a feature, the summary is consumed */
+  inline static void CarrySummary(utils::WQSummary *carry, size_t limit,
+                                  std::vector<utils::WQSummary> *levels) {
+    if (carry->size() == 0) return;
+    utils::WQSummary temp;
+    for (size_t l = 0;; ++l) {
+      if (l == levels->size()) levels->push_back(utils::WQSummary());
+      if ((*levels)[l].size() == 0) {
+        (*levels)[l].data.swap(carry->data); return;
+      }
+      temp.SetCombine((*levels)[l], *carry);
+      (*levels)[l].data.clear();
+      carry->SetPrune(temp, limit);
+    }
+  }
+  /*!
+   * \brief make the cuts of one feature from its summary
+   * \param s weighted quantile summary of the feature
+   * \param max_bin maximum number of bins
+   * \param out output cuts
+   */
+  inline static void MakeCuts(const utils::WQSummary &s, unsigned max_bin, std::vector<bst_float> *out) {
+    out->clear();
+    if (s.size() == 0) return;
+    if (s.size() <= max_bin) {
+      for (size_t i = 0; i + 1 < s.size(); ++i) {
+        out->push_back(MidPoint(s.data[i].value, s.data[i + 1].value));
+      }
+    } else {
+      // the kept values are evenly spread in weighted rank, each but the minimum and the maximum
+      // starts a new bin, the maximum falls in the last bin, which ends at the bound
+      utils::WQSummary pruned;
+      pruned.SetPrune(s, max_bin + 1);
+      for (size_t i = 1; i + 1 < pruned.size(); ++i) {
+        out->push_back(pruned.data[i].value);
+      }
+    }
+    const bst_float last = s.data.back().value;
+    bst_float bound = last + rt_eps;
+    if (!(bound > last)) bound = last + std::fabs(last) * rt_eps;
+    out->push_back(bound);
+  }
+  /*! \brief a value strictly above a and not above b */
+  inline static bst_float MidPoint(bst_float a, bst_float b) {
+    const bst_float mid = (a + b) * 0.5f;
+    return mid > a ? mid : b;
+  }
+};
+
+/*!
+ * \brief bin index of a matrix where every row has all the features in order,
+ *        only the local bin of each entry is stored, its feature is its position in the row
+ */
+template<typename BinType>
+struct DenseBinIndex {
+  const BinType *bin;
+  const unsigned *fptr;
+  DenseBinIndex(const BinType *bin, const unsigned *fptr) : bin(bin), fptr(fptr) {}
+  /*! \return global bin of entry j of the row that starts at entry rbegin */
+  inline unsigned Global(size_t j, size_t rbegin) const {
+    return fptr[j - rbegin] + bin[j];
+  }
+  /*! \return local bin of feature fid in the row of entries [rbegin, rend), -1 if it is missing */
+  inline int Local(unsigned fid, size_t rbegin, size_t rend) const {
+    return rbegin + fid < rend ? static_cast<int>(bin[rbegin + fid]) : -1;
+  }
+};
+/*! \brief bin index of a sparse matrix, the local bin and the feature of each entry are stored */
+template<typename BinType, typename FidType>
+struct SparseBinIndex {
+  const BinType *bin;
+  const FidType *fid;
+  const unsigned *fptr;
+  SparseBinIndex(const BinType *bin, const FidType *fid, const unsigned *fptr)
+      : bin(bin), fid(fid), fptr(fptr) {}
+  inline unsigned Global(size_t j, size_t rbegin) const {
+    return fptr[fid[j]] + bin[j];
+  }
+  inline int Local(unsigned f, size_t rbegin, size_t rend) const {
+    for (size_t j = rbegin; j < rend; ++j) {
+      if (fid[j] == f) return static_cast<int>(bin[j]);
+    }
+    return -1;
+  }
+};
+/*! \brief bin index of a sparse matrix, the global bin of each entry is stored, which tells its feature */
+template<typename BinType>
+struct GlobalBinIndex {
+  const BinType *bin;
+  const unsigned *fptr;
+  GlobalBinIndex(const BinType *bin, const unsigned *fptr) : bin(bin), fptr(fptr) {}
+  inline unsigned Global(size_t j, size_t rbegin) const {
+    return bin[j];
+  }
+  inline int Local(unsigned f, size_t rbegin, size_t rend) const {
+    for (size_t j = rbegin; j < rend; ++j) {
+      const unsigned b = bin[j];
+      if (b >= fptr[f] && b < fptr[f + 1]) return static_cast<int>(b - fptr[f]);
+    }
+    return -1;
+  }
+};
+
+/*!
+ * \brief feature matrix where each present entry is replaced by its bin, rows are stored in CSR format;
+ *        a dense matrix stores the bin of each entry within its feature, in 1 byte when max_bin <= 256,
+ *        its feature is its position in the row; a sparse matrix stores the local bin and the feature
+ *        of each entry, or the global bin when that is not larger; each in the smallest of 1, 2, 4 bytes
+ */
+class HistIndexMatrix {
+ public:
+  /*! \brief layout of the bins */
+  enum Layout {
+    kDense = 0,
+    kSparse = 1,
+    kGlobal = 2
+  };
+  /*! \brief cuts of the features */
+  HistCutMatrix cut;
+  /*! \brief start of each row */
+  std::vector<size_t> row_ptr;
+  /*! \brief layout of the bins */
+  int layout;
+  /*! \brief number of bytes of each bin, and of each feature index in the sparse layout */
+  int bin_bytes, fid_bytes;
+  HistIndexMatrix(void)
+      : layout(kDense), bin_bytes(0), fid_bytes(0), num_row_(0), num_entry_(0), max_bin_(0), eps_(0.0) {}
+  /*!
+   * \brief whether the matrix is built from a matrix of the shape of fmat with max_bin bins and
+   *        sketch error eps, the owner drops the matrix when the training data changes
+   */
+  inline bool Match(const IFMatrix &fmat, unsigned max_bin, double eps) const {
+    return num_row_ == fmat.NumRow() && num_entry_ == fmat.NumEntry() && max_bin_ == max_bin && eps_ == eps;
+  }
+  /*!
+   * \brief quantize a feature matrix
+   * \param fmat feature matrix
+   * \param weight weight of each row used to place the cuts, the hessian
+   * \param max_bin maximum number of bins of each feature
+   * \param eps error bound of the quantile sketches
+   */
+  inline void Init(const IFMatrix &fmat, const std::vector<float> &weight, unsigned max_bin, double eps) {
+    utils::Check(max_bin >= 2, "max_bin must be at least 2");
+    cut.Init(fmat, weight, max_bin, eps);
+    const unsigned ncol = static_cast<unsigned>(cut.row_ptr.size() - 1);
+    const unsigned nrow = static_cast<unsigned>(fmat.NumRow());
+    row_ptr.resize(nrow + 1);
+    row_ptr[0] = 0;
+    // a row is dense when it has every feature, in order
+    unsigned nsparse = 0;
+    #pragma omp parallel for schedule(static) reduction(+:nsparse)
+    for (unsigned i = 0; i < nrow; ++i) {
+      size_t cnt = 0;
+      bool dense = true;
+      for (IFMatrix::RowIter it = fmat.GetRow(i); it.Next(); ++cnt) {
+        if (it.findex() != cnt) dense = false;
+      }
+      row_ptr[i + 1] = cnt;
+      if (!dense || cnt != ncol) nsparse += 1;
+    }
+    for (unsigned i = 0; i < nrow; ++i) row_ptr[i + 1] += row_ptr[i];
+    unsigned max_nbin = 0;
+    for (unsigned fid = 0; fid < ncol; ++fid) {
+      max_nbin = std::max(max_nbin, cut.row_ptr[fid + 1] - cut.row_ptr[fid]);
+    }
+    const int global_bytes = NumBytes(cut.NumBin());
+    bin_bytes = NumBytes(max_nbin); fid_bytes = 0;
+    if (nsparse == 0) {
+      layout = kDense;
+    } else if (bin_bytes + NumBytes(ncol) < global_bytes) {
+      layout = kSparse; fid_bytes = NumBytes(ncol);
+    } else {
+      layout = kGlobal; bin_bytes = global_bytes;
+    }
+    bin_.resize(row_ptr.back() * bin_bytes);
+    fid_.resize(row_ptr.back() * fid_bytes);
+    switch (bin_bytes) {
+      case 1: this->FillBin(fmat, reinterpret_cast<uint8_t*>(BeginPtr(bin_))); break;
+      case 2: this->FillBin(fmat, reinterpret_cast<uint16_t*>(BeginPtr(bin_))); break;
+      default: this->FillBin(fmat, reinterpret_cast<uint32_t*>(BeginPtr(bin_))); break;
+    }
+    switch (fid_bytes) {
+      case 0: break;
+      case 1: this->FillFid(fmat, reinterpret_cast<uint8_t*>(BeginPtr(fid_))); break;
+      case 2: this->FillFid(fmat, reinterpret_cast<uint16_t*>(BeginPtr(fid_))); break;
+      default: this->FillFid(fmat, reinterpret_cast<uint32_t*>(BeginPtr(fid_))); break;
+    }
+    num_row_ = fmat.NumRow(); num_entry_ = fmat.NumEntry(); max_bin_ = max_bin; eps_ = eps;
+  }
+  /*!
+   * \brief call fn with the bin index of the layout, one of DenseBinIndex, SparseBinIndex
+   *        or GlobalBinIndex, fn has a template operator() taking the index
+   */
+  template<typename Fn>
+  inline void Visit(const Fn &fn) const {
+    const unsigned *fptr = &cut.row_ptr[0];
+    if (layout == kDense) {
+      switch (bin_bytes) {
+        case 1: fn(DenseBinIndex<uint8_t>(this->bin<uint8_t>(), fptr)); return;
+        case 2: fn(DenseBinIndex<uint16_t>(this->bin<uint16_t>(), fptr)); return;
+        default: fn(DenseBinIndex<uint32_t>(this->bin<uint32_t>(), fptr)); return;
+      }
+    }
+    if (layout == kGlobal) {
+      switch (bin_bytes) {
+        case 1: fn(GlobalBinIndex<uint8_t>(this->bin<uint8_t>(), fptr)); return;
+        case 2: fn(GlobalBinIndex<uint16_t>(this->bin<uint16_t>(), fptr)); return;
+        default: fn(GlobalBinIndex<uint32_t>(this->bin<uint32_t>(), fptr)); return;
+      }
+    }
+    // the sparse layout is only chosen when it takes less than 4 bytes
+    if (bin_bytes == 1 && fid_bytes == 2) {
+      fn(SparseBinIndex<uint8_t, uint16_t>(this->bin<uint8_t>(), this->fid<uint16_t>(), fptr));
+    } else {
+      utils::Assert(bin_bytes == 2 && fid_bytes == 1, "HistIndexMatrix: unexpected sparse layout");
+      fn(SparseBinIndex<uint16_t, uint8_t>(this->bin<uint16_t>(), this->fid<uint8_t>(), fptr));
+    }
+  }
+  /*! \return number of bytes of an entry */
+  inline int EntryBytes(void) const {
+    return bin_bytes + fid_bytes;
+  }
+  /*! \return number of bytes used by the bin indices */
+  inline size_t MemCost(void) const {
+    return bin_.size() + fid_.size() + row_ptr.size() * sizeof(size_t) + cut.cut.size() * sizeof(bst_float);
+  }
+
+ private:
+  /*! \return smallest of 1, 2, 4 bytes that holds values below n */
+  inline static int NumBytes(unsigned n) {
+    return n <= (1U << 8) ? 1 : (n <= (1U << 16) ? 2 : 4);
+  }
+  template<typename T>
+  inline const T *bin(void) const {
+    return reinterpret_cast<const T*>(BeginPtr(bin_));
+  }
+  template<typename T>
+  inline const T *fid(void) const {
+    return reinterpret_cast<const T*>(BeginPtr(fid_));
+  }
+  template<typename T>
+  inline void FillBin(const IFMatrix &fmat, T *dst) {
+    const unsigned nrow = static_cast<unsigned>(fmat.NumRow());
+    const bool local = layout != kGlobal;
+    #pragma omp parallel for schedule(static)
+    for (unsigned i = 0; i < nrow; ++i) {
+      T *p = dst + row_ptr[i];
+      for (IFMatrix::RowIter it = fmat.GetRow(i); it.Next();) {
+        const unsigned b = cut.GetBin(it.findex(), it.fvalue());
+        *p++ = static_cast<T>(local ? b - cut.row_ptr[it.findex()] : b);
+      }
+    }
+  }
+  template<typename T>
+  inline void FillFid(const IFMatrix &fmat, T *dst) {
+    const unsigned nrow = static_cast<unsigned>(fmat.NumRow());
+    #pragma omp parallel for schedule(static)
+    for (unsigned i = 0; i < nrow; ++i) {
+      T *p = dst + row_ptr[i];
+      for (IFMatrix::RowIter it = fmat.GetRow(i); it.Next();) {
+        *p++ = static_cast<T>(it.findex());
+      }
+    }
+  }
+  inline static unsigned char *BeginPtr(std::vector<unsigned char> &vec) {
+    return vec.size() == 0 ? NULL : &vec[0];
+  }
+  inline static const unsigned char *BeginPtr(const std::vector<unsigned char> &vec) {
+    return vec.size() == 0 ? NULL : &vec[0];
+  }
+  /*! \brief bin of each entry, local or global depending on the layout */
+  std::vector<unsigned char> bin_;
+  /*! \brief feature of each entry, only in the sparse layout */
+  std::vector<unsigned char> fid_;
+  /*! \brief shape of the matrix quantized and the quantization parameters, to tell whether it is still valid */
+  size_t num_row_, num_entry_;
+  unsigned max_bin_;
+  double eps_;
+};
+
+/*!
+ * \brief pool of node histograms of the same size, capped by a memory budget,
+ *        the buffers are recycled across levels and rounds instead of being reallocated
+ */
+class HistPool {
+ public:
+  HistPool(void) : nbin_(0), capacity_(0) {}
+  ~HistPool(void) {
+    this->Clear();
+  }
+  /*!
+   * \brief get ready for a new tree, all histograms are returned to the pool
+   * \param nbin number of bins of each histogram
+   * \param max_bytes memory budget, at least two histograms are allowed whatever the budget
+   */
+  inline void Init(unsigned nbin, size_t max_bytes) {
+    if (nbin != nbin_) {
+      this->Clear(); nbin_ = nbin;
+    }
+    capacity_ = std::max(static_cast<size_t>(2), max_bytes / (nbin_ * sizeof(GradStats) + 1));
+    while (data_.size() > capacity_) {
+      delete [] data_.back(); data_.pop_back();
+    }
+    free_.clear();
+    for (size_t i = data_.size(); i != 0; --i) {
+      free_.push_back(static_cast<int>(i - 1));
+    }
+  }
+  /*! \return id of a histogram, or -1 if the budget is used up, the content is undefined */
+  inline int Alloc(void) {
+    if (free_.size() != 0) {
+      const int id = free_.back();
+      free_.pop_back();
+      return id;
+    }
+    if (data_.size() >= capacity_) return -1;
+    data_.push_back(new GradStats[nbin_]);
+    return static_cast<int>(data_.size() - 1);
+  }
+  /*! \brief return a histogram to the pool */
+  inline void Free(int id) {
+    utils::Assert(id >= 0, "HistPool: free of an invalid id");
+    free_.push_back(id);
+  }
+  /*! \brief get the histogram of an id */
+  inline GradStats *operator[](int id) {
+    return data_[id];
+  }
+  /*! \return maximum number of histograms */
+  inline size_t capacity(void) const {
+    return capacity_;
+  }
+  /*! \return number of histograms Alloc can still give out */
+  inline size_t NumFree(void) const {
+    return free_.size() + capacity_ - data_.size();
+  }
+
+ private:
+  // the histograms are handed out by id, the pool can not be copied
+  HistPool(const HistPool &other);
+  HistPool &operator=(const HistPool &other);
+  inline void Clear(void) {
+    for (size_t i = 0; i < data_.size(); ++i) {
+      delete [] data_[i];
+    }
+    data_.clear(); free_.clear();
+  }
+  /*! \brief number of bins of each histogram */
+  unsigned nbin_;
+  /*! \brief maximum number of histograms */
+  size_t capacity_;
+  /*! \brief allocated histograms */
+  std::vector<GradStats*> data_;
+  /*! \brief ids of histograms not in use */
+  std::vector<int> free_;
+};
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_TREE_HIST_UTIL_H_
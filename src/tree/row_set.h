@@ -0,0 +1,159 @@
+#ifndef XGBOOST_TREE_ROW_SET_H_
+#define XGBOOST_TREE_ROW_SET_H_
+/*!
+ * \file row_set.h
+ * \brief row indices of the tree nodes, the rows of each node are kept contiguous
+ *        and in increasing order, and are partitioned in place when the node is split
+ */
+#include <vector>
+#include <algorithm>
+#include "../data.h"
+#include "../utils/utils.h"
+#include "../utils/omp.h"
+
+namespace xgboost {
+namespace gbm {
+/*! \brief number of rows in a block, the unit of parallel work over the rows of a node */
+const size_t kRowBlockSize = 2048;
+
+/*! \brief rows of each node, stored as ranges of one array of row indices */
+class RowSetCollection {
+ public:
+  /*!
+   * \brief group the rows by their initial node
+   * \param position node of each row, negative for rows not taking part
+   * \param num_nodes number of nodes of the tree
+   */
+  inline void Init(const std::vector<int> &position, int num_nodes) {
+    node_begin.resize(num_nodes); node_end.resize(num_nodes);
+    std::fill(node_end.begin(), node_end.end(), 0);
+    for (size_t i = 0; i < position.size(); ++i) {
+      if (position[i] >= 0) ++node_end[position[i]];
+    }
+    size_t start = 0;
+    for (int nid = 0; nid < num_nodes; ++nid) {
+      node_begin[nid] = start;
+      start += node_end[nid];
+      node_end[nid] = node_begin[nid];
+    }
+    row_index.resize(start);
+    for (size_t i = 0; i < position.size(); ++i) {
+      if (position[i] >= 0) row_index[node_end[position[i]]++] = static_cast<bst_uint>(i);
+    }
+  }
+  /*! \brief make the rows given the rows of node 0 */
+  inline void Init(const bst_uint *rows, size_t nrows) {
+    row_index.assign(rows, rows + nrows);
+    node_begin.assign(1, 0); node_end.assign(1, nrows);
+  }
+  /*! \return number of rows of node nid */
+  inline size_t Size(int nid) const {
+    return node_end[nid] - node_begin[nid];
+  }
+  /*! \return start of the rows of node nid */
+  inline const bst_uint *Rows(int nid) const {
+    return &row_index[0] + node_begin[nid];
+  }
+  /*!
+   * \brief stably partition the rows of each node into its two children, in parallel over blocks of rows,
+   *        each block is split into thread local buffers, then copied to the ranges of the children
+   * \param nodes nodes to be split
+   * \param cleft left child of each node
+   * \param cright right child of each node
+   * \param goleft functor, goleft(nid, ridx) tells whether row ridx of node nid goes left
+   * \tparam FGoLeft type of functor
+   */
+  template<typename FGoLeft>
+  inline void Partition(const std::vector<int> &nodes,
+                        const std::vector<int> &cleft,
+                        const std::vector<int> &cright,
+                        const FGoLeft &goleft) {
+    tasks.clear();
+    for (size_t k = 0; k < nodes.size(); ++k) {
+      const int nid = nodes[k];
+      for (size_t s = node_begin[nid]; s < node_end[nid]; s += kRowBlockSize) {
+        Task t;
+        t.node = k; t.begin = s; t.size = std::min(kRowBlockSize, node_end[nid] - s); t.nleft = 0;
+        tasks.push_back(t);
+      }
+    }
+    tmp.resize(row_index.size());
+    const unsigned ntask = static_cast<unsigned>(tasks.size());
+    #pragma omp parallel
+    {
+      std::vector<bst_uint> right;
+      #pragma omp for schedule(dynamic, 1)
+      for (unsigned i = 0; i < ntask; ++i) {
+        Task &t = tasks[i];
+        const int nid = nodes[t.node];
+        right.clear();
+        for (size_t j = t.begin; j < t.begin + t.size; ++j) {
+          const bst_uint ridx = row_index[j];
+          if (goleft(nid, ridx)) {
+            tmp[t.begin + t.nleft++] = ridx;
+          } else {
+            right.push_back(ridx);
+          }
+        }
+        std::copy(right.begin(), right.end(), tmp.begin() + t.begin + t.nleft);
+      }
+    }
+    // destination of each block, tasks of a node are in the order of its rows
+    std::vector<size_t> nleft(nodes.size(), 0);
+    for (unsigned i = 0; i < ntask; ++i) {
+      tasks[i].dst_left = nleft[tasks[i].node];
+      nleft[tasks[i].node] += tasks[i].nleft;
+    }
+    std::vector<size_t> nright(nodes.size(), 0);
+    for (unsigned i = 0; i < ntask; ++i) {
+      Task &t = tasks[i];
+      const size_t base = node_begin[nodes[t.node]];
+      t.dst_right = base + nleft[t.node] + nright[t.node];
+      t.dst_left += base;
+      nright[t.node] += t.size - t.nleft;
+    }
+    #pragma omp parallel for schedule(static)
+    for (unsigned i = 0; i < ntask; ++i) {
+      const Task &t = tasks[i];
+      std::copy(tmp.begin() + t.begin, tmp.begin() + t.begin + t.nleft, row_index.begin() + t.dst_left);
+      std::copy(tmp.begin() + t.begin + t.nleft, tmp.begin() + t.begin + t.size, row_index.begin() + t.dst_right);
+    }
+    for (size_t k = 0; k < nodes.size(); ++k) {
+      const int nid = nodes[k];
+      const size_t nmax = static_cast<size_t>(std::max(cleft[k], cright[k])) + 1;
+      if (node_begin.size() < nmax) {
+        node_begin.resize(nmax, 0); node_end.resize(nmax, 0);
+      }
+      node_begin[cleft[k]] = node_begin[nid];
+      node_end[cleft[k]] = node_begin[nid] + nleft[k];
+      node_begin[cright[k]] = node_end[cleft[k]];
+      node_end[cright[k]] = node_end[nid];
+    }
+  }
+
+ public:
+  /*! \brief row indices, grouped by node */
+  std::vector<bst_uint> row_index;
+  /*! \brief rows of node nid are row_index[node_begin[nid], node_end[nid]) */
+  std::vector<size_t> node_begin, node_end;
+
+ private:
+  /*! \brief a block of rows of a node to be partitioned */
+  struct Task {
+    /*! \brief index of the node in the split list */
+    size_t node;
+    /*! \brief start of the block in row_index and size */
+    size_t begin, size;
+    /*! \brief number of rows going left */
+    size_t nleft;
+    /*! \brief destination of the left and the right rows */
+    size_t dst_left, dst_right;
+  };
+  /*! \brief partition tasks */
+  std::vector<Task> tasks;
+  /*! \brief partitioned blocks before they are copied back */
+  std::vector<bst_uint> tmp;
+};
+}  // namespace gbm
+}  // namespace xgboost
+#endif  // XGBOOST_TREE_ROW_SET_H_
@@ -4,39 +4,197 @@
  * \file xgboost_svdf_tree.hpp
  * \brief implementation of regression tree constructor, with layerwise support
  *        this file is adapted from GBRT implementation in SVDFeature project
- * \author Tianqi Chen: tqchen@apex.sjtu.edu.cn, tianqi.tchen@gmail.com 
+ *
+ *        the tree is grown level by level, all the nodes of a level are expanded
+ *        by one scan over each sorted column, features are enumerated in parallel
+ * \author Tianqi Chen: tqchen@apex.sjtu.edu.cn, tianqi.tchen@gmail.com
  */
+#include <vector>
 #include <algorithm>
 #include "tree_model.h"
-#include "../utils/random.h"
-#include "../utils/matrix_csr.h"
+#include "base_treemaker.hpp"
+#include "../data.h"
+#include "../utils/omp.h"
 
 namespace xgboost {
-namespace gbm {                
+namespace gbm {
 // updater of rtree, allows the parameters to be stored inside, key solver
-class RTreeUpdater {
- private:
-  // training parameter
-  const TreeParamTrain &param;
-  // parameters, reference
-  RegTree &tree;
-  std::vector<float> &grad;
-  std::vector<float> &hess;
-  const IFMatrix &smat;
-  const std::vector<unsigned> &group_id;
+class RTreeUpdater : public BaseTreeMaker {
  public:
-  RTreeUpdater(const TreeParamTrain &pparam, 
+  RTreeUpdater(const TreeParamTrain &pparam,
+               const utils::FeatConstrain &pconstrain,
                RegTree &ptree,
                std::vector<float> &pgrad,
                std::vector<float> &phess,
-               const IFMatrix &psmat, 
-               const std::vector<unsigned> &pgroup_id):
-      param(pparam), tree(ptree), grad(pgrad), hess(phess),
-      smat(psmat), group_id(pgroup_id) {
+               const IFMatrix &psmat,
+               const std::vector<unsigned> &pgroup_id,
+               int psilent = 1):
+      BaseTreeMaker(pparam, pconstrain, ptree, pgrad, phess, psmat, pgroup_id, psilent) {
+  }
+  /*!
+   * \brief grow the tree with the gradient statistics
+   * \param num_pruned output number of nodes pruned after growing
+   * \return maximum depth of the tree
+   */
+  inline int do_boost(int &num_pruned) {
+    utils::Check(smat.HaveColAccess(), "RTreeUpdater: feature matrix need column access");
+    utils::Check(param.grow_policy == 0, "RTreeUpdater: grow_policy=lossguide needs a histogram tree maker");
+    this->InitData();
+    this->InitFeatures(static_cast<unsigned>(smat.NumCol()));
+    stemp.resize(omp_get_max_threads(), std::vector<ThreadEntry>());
+    for (int depth = 0; depth < param.max_depth && qexpand.size() != 0; ++depth) {
+      const double tstart = utils::GetTime();
+      this->FindSplit(depth);
+      const double tsplit = utils::GetTime();
+      this->ResetPosition();
+      this->UpdatePosition();
+      this->UpdateQueueExpand();
+      if (!silent) {
+        printf("level %d: find split %.3f sec, update position %.3f sec, %lu nodes to expand\n",
+               depth, tsplit - tstart, utils::GetTime() - tsplit,
+               static_cast<unsigned long>(qexpand.size()));
+      }
+    }
+    return this->Finish(num_pruned);
+  }
+
+ private:
+  /*! \brief per thread statistics of a node while scanning a column */
+  struct ThreadEntry {
+    /*! \brief statistics of the instances visited so far */
+    GradStats stats;
+    /*! \brief statistics of all the instances with present value */
+    GradStats present;
+    /*! \brief last feature value visited */
+    float last_fvalue;
+    /*! \brief whether no instance is visited yet */
+    bool first;
+    /*! \brief best split found by the thread */
+    SplitEntry best;
+  };
+  /*!
+   * \brief enumerate the split points of one column for all nodes in the queue,
+   *        only the present entries are visited, the missing rows of a node are its
+   *        statistics minus the present ones; with missing value going right the left child
+   *        is the visited part, with missing value going left the right child is the part not visited yet,
+   *        default_direction=learn tries both
+   */
+  inline void EnumerateSplit(unsigned fid, std::vector<ThreadEntry> &temp) {
+    const bool miss_right = param.default_direction != 1;
+    const bool miss_left = param.default_direction != 2;
+    for (size_t i = 0; i < qexpand.size(); ++i) {
+      ThreadEntry &e = temp[qexpand[i]];
+      e.stats.Clear(); e.present.Clear();
+      e.last_fvalue = 0.0f;
+      e.first = true;
+    }
+    if (miss_left) {
+      // sum of the present entries, needed before the scan to know the right child
+      for (IFMatrix::ColIter it = smat.GetSortedCol(fid); it.Next();) {
+        const bst_uint ridx = it.rindex();
+        const int nid = position[ridx];
+        if (nid < 0) continue;
+        temp[nid].present.Add(grad[ridx], hess[ridx]);
+      }
+    }
+    GradStats l, r;
+    for (IFMatrix::ColIter it = smat.GetSortedCol(fid); it.Next();) {
+      const bst_uint ridx = it.rindex();
+      const int nid = position[ridx];
+      if (nid < 0) continue;
+      ThreadEntry &e = temp[nid];
+      const NodeEntry &s = snode[nid];
+      const float fvalue = it.fvalue();
+      // split between the last value and current value, before the first value only missing ones go left
+      if (e.first || fvalue > e.last_fvalue + rt_2eps) {
+        const float split_value = e.first ? fvalue - rt_eps : (fvalue + e.last_fvalue) * 0.5f;
+        if (miss_right && !e.first && e.stats.sum_hess >= param.min_child_weight) {
+          r.SetSubstract(s.stats, e.stats);
+          if (r.sum_hess >= param.min_child_weight) {
+            const double loss_chg = e.stats.CalcGain(param) + r.CalcGain(param) - s.root_gain;
+            e.best.Update(static_cast<float>(loss_chg), fid, split_value, false, e.stats);
+          }
+        }
+        if (miss_left) {
+          r.SetSubstract(e.present, e.stats);
+          l.SetSubstract(s.stats, r);
+          if (l.sum_hess >= param.min_child_weight && r.sum_hess >= param.min_child_weight) {
+            const double loss_chg = l.CalcGain(param) + r.CalcGain(param) - s.root_gain;
+            e.best.Update(static_cast<float>(loss_chg), fid, split_value, true, l);
+          }
+        }
+      }
+      e.stats.Add(grad[ridx], hess[ridx]);
+      e.last_fvalue = fvalue;
+      e.first = false;
+    }
+    // split after the largest value, which separates the present values from missing ones
+    if (!miss_right) return;
+    for (size_t i = 0; i < qexpand.size(); ++i) {
+      const int nid = qexpand[i];
+      ThreadEntry &e = temp[nid];
+      if (e.stats.sum_hess < param.min_child_weight) continue;
+      r.SetSubstract(snode[nid].stats, e.stats);
+      if (r.sum_hess >= param.min_child_weight) {
+        const double loss_chg = e.stats.CalcGain(param) + r.CalcGain(param) - snode[nid].root_gain;
+        e.best.Update(static_cast<float>(loss_chg), fid, e.last_fvalue + rt_eps, false, e.stats);
+      }
+    }
   }
+  /*! \brief find the best split of each node in the queue, and add the children */
+  inline void FindSplit(int depth) {
+    const int num_nodes = tree.param.num_nodes;
+    for (size_t tid = 0; tid < stemp.size(); ++tid) {
+      stemp[tid].resize(num_nodes, ThreadEntry());
+      for (size_t i = 0; i < qexpand.size(); ++i) {
+        stemp[tid][qexpand[i]].best = SplitEntry();
+      }
+    }
+    // only the features drawn for this level are scanned
+    const std::vector<unsigned> &feats = this->LevelFeatures(depth);
+    const unsigned nfeat = static_cast<unsigned>(feats.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (unsigned i = 0; i < nfeat; ++i) {
+      this->EnumerateSplit(feats[i], stemp[omp_get_thread_num()]);
+    }
+    for (size_t i = 0; i < qexpand.size(); ++i) {
+      const int nid = qexpand[i];
+      for (size_t tid = 0; tid < stemp.size(); ++tid) {
+        snode[nid].best.Update(stemp[tid][nid].best);
+      }
+      this->ApplySplit(nid, depth);
+    }
+  }
+  /*! \brief move the rows with present value of split feature to the correct child */
+  inline void UpdatePosition(void) {
+    std::vector<unsigned> fsplits;
+    for (size_t i = 0; i < qexpand.size(); ++i) {
+      const int nid = qexpand[i];
+      if (!tree[nid].is_leaf()) fsplits.push_back(tree[nid].split_index());
+    }
+    std::sort(fsplits.begin(), fsplits.end());
+    fsplits.resize(std::unique(fsplits.begin(), fsplits.end()) - fsplits.begin());
+    // a row is only written by the column its parent splits on, the other columns
+    // only read it to find the parent, which is the same before and after the write
+    const unsigned nsplit = static_cast<unsigned>(fsplits.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (unsigned i = 0; i < nsplit; ++i) {
+      const unsigned fid = fsplits[i];
+      for (IFMatrix::ColIter it = smat.GetSortedCol(fid); it.Next();) {
+        const bst_uint ridx = it.rindex();
+        const int nid = position[ridx];
+        if (nid < 0) continue;
+        const int pid = tree[nid].parent();
+        if (tree[pid].split_index() == fid) {
+          position[ridx] = it.fvalue() < tree[pid].split_cond() ? tree[pid].cleft() : tree[pid].cright();
+        }
+      }
+    }
+  }
+ private:
+  /*! \brief per thread statistics of each node */
+  std::vector< std::vector<ThreadEntry> > stemp;
 };
 }  // namespace gbm
 }  // namespace xgboost
 #endif
-
-
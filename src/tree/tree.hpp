@@ -21,10 +21,10 @@ namespace gbm {
   }
 };
 };
+#include <limits>
 #include "../utils/fmap.h"
 #include "svdf_tree.hpp"
-//#include "xgboost_col_treemaker.hpp"
-//#include "xgboost_row_treemaker.hpp"
+#include "hist_treemaker.hpp"
 
 namespace xgboost {
 namespace gbm {
@@ -33,9 +33,8 @@ namespace gbm {
 class RegTreeTrainer : public IGradBooster {
  public:
   RegTreeTrainer(void) { 
-    silent = 0; tree_maker = 1; 
-    // normally we won't have more than 64 OpenMP threads
-    threadtemp.resize(64, ThreadEntry());
+    silent = 0; tree_maker = 0; cache = NULL;
+    this->InitThreadTemp();
   }
   virtual ~RegTreeTrainer(void) {}
  public:
@@ -48,12 +47,14 @@ class RegTreeTrainer : public IGradBooster {
   }
   virtual void LoadModel(utils::IStream &fi) {
     tree.LoadModel(fi );
+    this->InitThreadTemp();
   }
   virtual void SaveModel(utils::IStream &fo) const {
     tree.SaveModel(fo);
   }
   virtual void InitModel(void) {
     tree.InitModel();
+    this->InitThreadTemp();
   }
  public:
   virtual void DoBoost(std::vector<float> &grad, 
@@ -64,23 +65,64 @@ class RegTreeTrainer : public IGradBooster {
     if (!silent) {
       printf("\nbuild GBRT with %u instances\n", (unsigned)grad.size());
     }
+    this->InitThreadTemp();
     int num_pruned;
     switch (tree_maker) {
       case 0: {
-        utils::Assert(!constrain.HasConstrain(), "tree maker 0 does not support constrain");
-        RTreeUpdater updater(param, tree, grad, hess, smat, root_index);
-        //tree.param.max_depth = updater.do_boost( num_pruned );
+        RTreeUpdater updater(param, constrain, tree, grad, hess, smat, root_index, silent);
+        tree.param.max_depth = updater.do_boost(num_pruned);
         break;
       }
+      case 1:
+      case 2: {
+        // without the slot of a model, the booster quantizes the data for itself
+        IBoosterCache *own = NULL;
+        HistCache &hcache = HistCache::Get(cache != NULL ? cache : &own);
+        HistTreeMaker maker(param, constrain, tree, grad, hess, smat, root_index, hcache, tree_maker == 1, silent);
+        tree.param.max_depth = maker.do_boost(num_pruned);
+        delete own;
+        break;
+      }
+      default: utils::Error("unknown tree maker");
+    }
+    if (!silent) {
+      printf("tree train end, %d roots, %d extra nodes, %d pruned nodes, max_depth=%d\n",
+             tree.param.num_roots, tree.num_extra_nodes(), num_pruned, tree.param.max_depth);
     }
   }            
+  /*!
+   * \brief predict a row, a dense row is used in place, a sparse row is scattered into
+   *        the dense scratch of the thread, and only the slots it set are cleared afterwards
+   */
   virtual float Predict(const IFMatrix &fmat, bst_uint ridx, unsigned gid = 0) {     
-    return 0.0f;  
+    size_t ncol;
+    const bst_float *row = fmat.GetDenseRow(ridx, &ncol);
+    if (row != NULL) {
+      return tree[this->GetLeafIndex(DenseFeat(row, ncol), gid)].leaf_value();
+    }
+    const int tid = omp_get_thread_num();
+    utils::Assert(tid < static_cast<int>(threadtemp.size()), "RegTreeTrainer: more threads than scratch");
+    ThreadEntry &e = threadtemp[tid];
+    for (IFMatrix::RowIter it = fmat.GetRow(ridx); it.Next();) {
+      e.Set(it.findex(), it.fvalue());
+    }
+    const int nid = this->GetLeafIndex(e, gid);
+    for (IFMatrix::RowIter it = fmat.GetRow(ridx); it.Next();) {
+      e.Drop(it.findex());
+    }
+    return tree[nid].leaf_value();
+  }
+  virtual void SetCache(IBoosterCache **slot) {
+    cache = slot;
+  }
+  virtual const RegTree *GetTree(void) const {
+    return &tree;
   }
   virtual float Predict(const std::vector<float> &feat, 
                         const std::vector<bool> &funknown,
                         unsigned gid = 0) {
-    return 0.0f; 
+    utils::Assert(feat.size() == funknown.size(), "RegTreeTrainer: feat and funknown size mismatch");
+    return tree[this->GetLeafIndex(VecFeat(feat, funknown), gid)].leaf_value();
   }            
 
  private:
@@ -93,11 +135,74 @@ class RegTreeTrainer : public IGradBooster {
   int tree_maker;
   // feature constrain
   utils::FeatConstrain constrain;  
+  // cache slot of the model, NULL if not given
+  IBoosterCache **cache;
  private:
+  /*! \brief dense scratch of a row, NaN marks missing value, only the present features are set */
   struct ThreadEntry {
     std::vector<float> feat;
-    std::vector<bool> funknown;
+    inline void Set(unsigned fid, float fvalue) {
+      if (fid >= feat.size()) feat.resize(fid + 1, std::numeric_limits<float>::quiet_NaN());
+      feat[fid] = fvalue;
+    }
+    inline void Drop(unsigned fid) {
+      feat[fid] = std::numeric_limits<float>::quiet_NaN();
+    }
+    inline bool unknown(unsigned fid) const {
+      return fid >= feat.size() || feat[fid] != feat[fid];
+    }
+    inline float fvalue(unsigned fid) const {
+      return feat[fid];
+    }
+  };
+  /*! \brief a row stored densely by the feature matrix, NaN marks missing value */
+  struct DenseFeat {
+    const bst_float *row;
+    size_t ncol;
+    DenseFeat(const bst_float *row, size_t ncol) : row(row), ncol(ncol) {}
+    inline bool unknown(unsigned fid) const {
+      return fid >= ncol || row[fid] != row[fid];
+    }
+    inline float fvalue(unsigned fid) const {
+      return row[fid];
+    }
   };
+  /*! \brief a row given as values and missing flags */
+  struct VecFeat {
+    const std::vector<float> &feat;
+    const std::vector<bool> &funknown;
+    VecFeat(const std::vector<float> &feat, const std::vector<bool> &funknown)
+        : feat(feat), funknown(funknown) {}
+    inline bool unknown(unsigned fid) const {
+      return fid >= funknown.size() || funknown[fid];
+    }
+    inline float fvalue(unsigned fid) const {
+      return feat[fid];
+    }
+  };
+  /*! \brief get the leaf a row falls into starting from root gid */
+  template<typename FeatType>
+  inline int GetLeafIndex(const FeatType &feat, unsigned gid) const {
+    int pid = static_cast<int>(gid);
+    while (!tree[pid].is_leaf()) {
+      const unsigned split_index = tree[pid].split_index();
+      if (feat.unknown(split_index)) {
+        pid = tree[pid].cdefault();
+      } else {
+        pid = feat.fvalue(split_index) < tree[pid].split_cond() ? tree[pid].cleft() : tree[pid].cright();
+      }
+    }
+    return pid;
+  }
+  /*!
+   * \brief give each OpenMP thread a scratch, called out of parallel regions before prediction,
+   *        the scratch of a thread only grows in the thread itself
+   */
+  inline void InitThreadTemp(void) {
+    const size_t nthread = static_cast<size_t>(omp_get_max_threads());
+    if (threadtemp.size() < nthread) threadtemp.resize(nthread, ThreadEntry());
+  }
+  /*! \brief per thread scratch for prediction */
   std::vector<ThreadEntry> threadtemp;
 };
 }  // namespace gbm
@@ -7,6 +7,8 @@
  * \author Tianqi Chen: tianqi.tchen@gmail.com
  */
 #include <cstring>
+#include <vector>
+#include <algorithm>
 #include "../utils/utils.h"
 #include "../utils/io.h"
 
@@ -181,6 +183,97 @@ class TreeModel {
       nodes[i].set_parent(-1);
     }
   }
+  /*! \brief get node given nid */
+  inline Node &operator[](int nid) {
+    return nodes[nid];
+  }
+  /*! \brief get node given nid */
+  inline const Node &operator[](int nid) const {
+    return nodes[nid];
+  }
+  /*! \brief get node statistics given nid */
+  inline NodeStat &stat(int nid) {
+    return stats[nid];
+  }
+  /*! \brief get node statistics given nid */
+  inline const NodeStat &stat(int nid) const {
+    return stats[nid];
+  }
+  /*! 
+   * \brief add child nodes to node
+   * \param nid node id to add childs
+   */
+  inline void AddChilds(int nid) {
+    int pleft  = this->AllocNode();
+    int pright = this->AllocNode();
+    nodes[nid].cleft_  = pleft;
+    nodes[nid].cright_ = pright;
+    nodes[pleft].set_parent(nid, true);
+    nodes[pright].set_parent(nid, false);
+  }
+  /*! 
+   * \brief change a non leaf node to a leaf node, delete its children
+   * \param rid node id of the node
+   * \param value new leaf value
+   */
+  inline void ChangeToLeaf(int rid, float value) {
+    utils::Assert(nodes[nodes[rid].cleft()].is_leaf(), "can not delete a non termial child");
+    utils::Assert(nodes[nodes[rid].cright()].is_leaf(), "can not delete a non termial child");
+    this->DeleteNode(nodes[rid].cleft());
+    this->DeleteNode(nodes[rid].cright());
+    nodes[rid].set_leaf(value);
+  }
+  /*!
+   * \brief make leaf nid a copy of the subtree of node sid in src, used to put together
+   *        subtrees grown separately
+   * \param nid a leaf of this tree
+   * \param src source tree
+   * \param sid root of the subtree in src
+   */
+  inline void CopySubtree(int nid, const TreeModel &src, int sid) {
+    const Node &s = src.nodes[sid];
+    stats[nid] = src.stats[sid];
+    if (s.is_leaf()) {
+      nodes[nid].set_leaf(s.leaf_value()); return;
+    }
+    this->AddChilds(nid);
+    nodes[nid].set_split(s.split_index(), s.split_cond(), s.default_left());
+    this->CopySubtree(nodes[nid].cleft(), src, s.cleft());
+    this->CopySubtree(nodes[nid].cright(), src, s.cright());
+  }
+  /*! \brief number of extra nodes besides the roots */
+  inline int num_extra_nodes(void) const {
+    return param.num_nodes - param.num_roots - param.num_deleted;
+  }
+  /*! 
+   * \brief get current depth
+   * \param nid node id
+   */
+  inline int GetDepth(int nid) const {
+    int depth = 0;
+    while (!nodes[nid].is_root()) {
+      ++depth;
+      nid = nodes[nid].parent();
+    }
+    return depth;
+  }
+  /*! 
+   * \brief get maximum depth of the subtree
+   * \param nid node id
+   */
+  inline int MaxDepth(int nid) const {
+    if (nodes[nid].is_leaf()) return 0;
+    return std::max(MaxDepth(nodes[nid].cleft()) + 1,
+                    MaxDepth(nodes[nid].cright()) + 1);
+  }
+  /*! \brief get maximum depth of all the roots */
+  inline int MaxDepth(void) const {
+    int maxd = 0;
+    for (int i = 0; i < param.num_roots; ++i) {
+      maxd = std::max(maxd, MaxDepth(i));
+    }
+    return maxd;
+  }
   /*! 
    * \brief save model to stream
    * \param fo output stream
@@ -208,6 +301,27 @@ class TreeModel {
     }
     utils::Assert( (int)deleted_nodes.size() == param.num_deleted, "number of deleted nodes do not match" );
   }
+ private:
+  /*! \brief allocate a new node, reuse the deleted ones if possible */
+  inline int AllocNode(void) {
+    if (param.num_deleted != 0) {
+      int nd = deleted_nodes.back();
+      deleted_nodes.pop_back();
+      --param.num_deleted;
+      return nd;
+    }
+    int nd = param.num_nodes++;
+    nodes.resize(param.num_nodes);
+    stats.resize(param.num_nodes);
+    return nd;
+  }
+  /*! \brief delete a tree node, the node is marked by setting its parent to -1 */
+  inline void DeleteNode(int nid) {
+    utils::Assert(nid >= param.num_roots, "can not delete root");
+    deleted_nodes.push_back(nid);
+    nodes[nid].set_parent(-1);
+    ++param.num_deleted;
+  }
 };
 
 
@@ -218,8 +332,12 @@ struct TreeParamTrain {
   float learning_rate;
   // minimum loss change required for a split
   float min_split_loss;
-  // maximum depth of a tree
+  // maximum depth of a tree, no limit if not positive under lossguide growth
   int max_depth;
+  // how the tree is grown, 0: depthwise, level by level, 1: lossguide, best split first
+  int grow_policy;
+  // maximum number of leaves of a tree under lossguide growth, 0 means no limit
+  int max_leaves;
   //----- the rest parameters are less important ----
   // minimum amount of hessian(weight) allowed in a child
   float min_child_weight;
@@ -229,22 +347,46 @@ struct TreeParamTrain {
   int reg_method;
   // default direction choice
   int default_direction;
-  // whether we want to do subsample
+  // fraction of rows used to grow each tree
   float subsample;
+  // how rows are subsampled, 0: uniform, 1: goss, gradient-based one-side sampling
+  int sampling_method;
+  // fraction of rows with the largest |grad| always kept by goss, the rest of subsample is drawn at random
+  float goss_top_rate;
+  // fraction of the features drawn for each tree
+  float colsample_bytree;
+  // fraction of the features of the tree drawn for each level
+  float colsample_bylevel;
   // whether to use layerwise aware regularization
   int use_layerwise;
+  // maximum number of bins of each feature in histogram tree maker
+  int max_bin;
+  // error bound of the quantile sketches that place the bins, 0 means half of a bin: 0.5 / max_bin
+  float sketch_eps;
+  // memory budget of the node histograms in histogram tree maker, in MB
+  int max_hist_mem;
   // number of threads to be used for tree construction, if OpenMP is enabled, if equals 0, use system default
   int nthread;
   /*! \brief constructor */
   TreeParamTrain(void) {
     learning_rate = 0.3f;
+    min_split_loss = 0.0f;
     min_child_weight = 1.0f;
     max_depth = 6;
+    grow_policy = 0;
+    max_leaves = 0;
     reg_lambda = 1.0f;
     reg_method = 2;
     default_direction = 0;
     subsample = 1.0f;
+    sampling_method = 0;
+    goss_top_rate = 0.1f;
+    colsample_bytree = 1.0f;
+    colsample_bylevel = 1.0f;
     use_layerwise = 0;
+    max_bin = 256;
+    sketch_eps = 0.0f;
+    max_hist_mem = 1024;
     nthread = 0;
   }
   /*! 
@@ -265,13 +407,150 @@ struct TreeParamTrain {
     if( !strcmp( name, "reg_lambda") )        reg_lambda = (float)atof( val );
     if( !strcmp( name, "reg_method") )        reg_method = (float)atof( val );
     if( !strcmp( name, "subsample") )         subsample  = (float)atof( val );
+    if( !strcmp( name, "goss_top_rate") )     goss_top_rate = (float)atof( val );
+    if( !strcmp( name, "colsample_bytree") )  colsample_bytree = (float)atof( val );
+    if( !strcmp( name, "colsample_bylevel") ) colsample_bylevel = (float)atof( val );
     if( !strcmp( name, "use_layerwise") )     use_layerwise = atoi( val );
+    if( !strcmp( name, "max_leaves") )        max_leaves = atoi( val );
+    if( !strcmp( name, "max_bin") )           max_bin = atoi( val );
+    if( !strcmp( name, "sketch_eps") )        sketch_eps = (float)atof( val );
+    if( !strcmp( name, "max_hist_mem") )      max_hist_mem = atoi( val );
     if( !strcmp( name, "nthread") )           nthread = atoi( val );
     if( !strcmp( name, "default_direction") ) {
       if( !strcmp( val, "learn") )  default_direction = 0;
       if( !strcmp( val, "left") )   default_direction = 1;
       if( !strcmp( val, "right") )  default_direction = 2;
     }
+    if( !strcmp( name, "sampling_method") ) {
+      if( !strcmp( val, "uniform") ) sampling_method = 0;
+      if( !strcmp( val, "goss") )    sampling_method = 1;
+    }
+    if( !strcmp( name, "grow_policy") ) {
+      if( !strcmp( val, "depthwise") ) grow_policy = 0;
+      if( !strcmp( val, "lossguide") ) grow_policy = 1;
+    }
+  }
+  /*! \brief calculate the cost of loss function of a node with given statistics */
+  inline double CalcGain(double sum_grad, double sum_hess) const {
+    if (sum_hess < min_child_weight) return 0.0;
+    switch (reg_method) {
+      case 1 : return Sqr(ThresholdL1(sum_grad, reg_lambda)) / sum_hess;
+      case 2 : return Sqr(sum_grad) / (sum_hess + reg_lambda);
+      case 3 : return Sqr(ThresholdL1(sum_grad, 0.5 * reg_lambda)) / (sum_hess + 0.5 * reg_lambda);
+      default: return Sqr(sum_grad) / sum_hess;
+    }
+  }
+  /*! \brief calculate the weight of a leaf with given statistics */
+  inline double CalcWeight(double sum_grad, double sum_hess) const {
+    if (sum_hess < min_child_weight) return 0.0;
+    switch (reg_method) {
+      case 1 : return - ThresholdL1(sum_grad, reg_lambda) / sum_hess;
+      case 2 : return - sum_grad / (sum_hess + reg_lambda);
+      case 3 : return - ThresholdL1(sum_grad, 0.5 * reg_lambda) / (sum_hess + 0.5 * reg_lambda);
+      default: return - sum_grad / sum_hess;
+    }
+  }
+  /*! \brief whether a node with given statistics at given depth can not be split */
+  inline bool CannotSplit(double sum_hess, int depth) const {
+    return sum_hess < min_child_weight * 2.0 || (max_depth > 0 && depth >= max_depth);
+  }
+ private:
+  inline static double Sqr(double a) {
+    return a * a;
+  }
+  inline static double ThresholdL1(double w, double lambda) {
+    if (w > +lambda) return w - lambda;
+    if (w < -lambda) return w + lambda;
+    return 0.0;
+  }
+};
+
+/*! \brief sum of gradient statistics of a set of instances */
+struct GradStats {
+  /*! \brief sum of first order gradient */
+  double sum_grad;
+  /*! \brief sum of second order gradient */
+  double sum_hess;
+  /*! \brief constructor */
+  GradStats(void) : sum_grad(0.0), sum_hess(0.0) {}
+  /*! \brief clear the statistics */
+  inline void Clear(void) {
+    sum_grad = sum_hess = 0.0;
+  }
+  /*! \brief add statistics of one instance */
+  inline void Add(double grad, double hess) {
+    sum_grad += grad; sum_hess += hess;
+  }
+  /*! \brief add statistics of another set */
+  inline void Add(const GradStats &b) {
+    this->Add(b.sum_grad, b.sum_hess);
+  }
+  /*! \brief set current value to a - b */
+  inline void SetSubstract(const GradStats &a, const GradStats &b) {
+    sum_grad = a.sum_grad - b.sum_grad;
+    sum_hess = a.sum_hess - b.sum_hess;
+  }
+  /*! \return cost of loss function of the set */
+  inline double CalcGain(const TreeParamTrain &param) const {
+    return param.CalcGain(sum_grad, sum_hess);
+  }
+  /*! \return weight of the set as a leaf */
+  inline double CalcWeight(const TreeParamTrain &param) const {
+    return param.CalcWeight(sum_grad, sum_hess);
+  }
+};
+
+/*! \brief candidate split of a node, along with the statistics of its left side */
+struct SplitEntry {
+  /*! \brief loss change after the split */
+  float loss_chg;
+  /*! \brief split index, the highest bit indicates whether missing value goes left */
+  unsigned sindex;
+  /*! \brief split value */
+  float split_value;
+  /*! \brief statistics of the left child */
+  GradStats left_sum;
+  /*! \brief constructor */
+  SplitEntry(void) : loss_chg(0.0f), sindex(0), split_value(0.0f) {}
+  /*! 
+   * \brief whether a split with given loss change and feature replaces current one,
+   *        ties are broken by smaller feature index, so that the result does not
+   *        depend on the order the features are visited
+   */
+  inline bool NeedReplace(float new_loss_chg, unsigned split_index) const {
+    if (this->split_index() <= split_index) {
+      return new_loss_chg > this->loss_chg;
+    } else {
+      return !(this->loss_chg > new_loss_chg);
+    }
+  }
+  /*! \brief update the split with another candidate, return whether it is replaced */
+  inline bool Update(const SplitEntry &e) {
+    if (this->NeedReplace(e.loss_chg, e.split_index())) {
+      *this = e; return true;
+    }
+    return false;
+  }
+  /*! \brief update the split with a new candidate, return whether it is replaced */
+  inline bool Update(float new_loss_chg, unsigned split_index, float new_split_value,
+                     bool default_left, const GradStats &left) {
+    if (this->NeedReplace(new_loss_chg, split_index)) {
+      if (default_left) split_index |= (1U << 31);
+      loss_chg = new_loss_chg;
+      sindex = split_index;
+      split_value = new_split_value;
+      left_sum = left;
+      return true;
+    }
+    return false;
+  }
+  /*! \return feature index to split on */
+  inline unsigned split_index(void) const {
+    return sindex & ((1U << 31) - 1U);
+  }
+  /*! \return whether missing value goes left */
+  inline bool default_left(void) const {
+    return (sindex >> 31) != 0;
   }
 };
 
@@ -0,0 +1,136 @@
+#ifndef XGBOOST_UTILS_LZ_H_
+#define XGBOOST_UTILS_LZ_H_
+/*!
+ * \file lz.h
+ * \brief fast LZ77 style codec, used to compress blocks of binary buffer
+ *     Format: a sequence of
+ *        token, [extra literal length], literals, offset, [extra match length]
+ *     token holds literal length in the high 4 bits and match length minus 4 in the low 4 bits,
+ *     a value of 15 is followed by bytes of 255 and one byte below 255 that are added to it,
+ *     offset is 2 bytes little endian; the last sequence only has token and literals
+ */
+#include <vector>
+#include <cstring>
+#include <inttypes.h>
+
+namespace xgboost {
+namespace utils {
+/*! \brief size of hash table of compressor, in bits */
+const int kLZHashBits = 16;
+/*! \brief minimum length of match */
+const size_t kLZMinMatch = 4;
+/*! \brief maximum distance of match */
+const size_t kLZMaxOffset = 65535;
+
+/*! \brief read 4 bytes at p */
+inline uint32_t LZRead32(const unsigned char *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+/*! \brief append a length that does not fit in the token */
+inline void LZPutLength(size_t len, std::vector<unsigned char> *out) {
+  for (; len >= 255; len -= 255) out->push_back(255);
+  out->push_back(static_cast<unsigned char>(len));
+}
+/*! \brief append one sequence, match_len is 0 for the last sequence */
+inline void LZPutSequence(const unsigned char *lit, size_t lit_len,
+                          size_t offset, size_t match_len,
+                          std::vector<unsigned char> *out) {
+  const size_t ml = match_len == 0 ? 0 : match_len - kLZMinMatch;
+  out->push_back(static_cast<unsigned char>(((lit_len < 15 ? lit_len : 15) << 4) |
+                                            (ml < 15 ? ml : 15)));
+  if (lit_len >= 15) LZPutLength(lit_len - 15, out);
+  out->insert(out->end(), lit, lit + lit_len);
+  if (match_len == 0) return;
+  out->push_back(static_cast<unsigned char>(offset & 0xff));
+  out->push_back(static_cast<unsigned char>(offset >> 8));
+  if (ml >= 15) LZPutLength(ml - 15, out);
+}
+/*!
+ * \brief compress a block
+ * \param src content to compress
+ * \param n number of bytes
+ * \param out output, compressed bytes are appended to it
+ */
+inline void LZCompress(const void *src, size_t n, std::vector<unsigned char> *out) {
+  const unsigned char *s = static_cast<const unsigned char*>(src);
+  // position plus one of the last occurrence of each hash, 0 means none
+  std::vector<size_t> table(1 << kLZHashBits, 0);
+  size_t anchor = 0, i = 0, miss = 0;
+  while (i + kLZMinMatch <= n) {
+    const uint32_t v = LZRead32(s + i);
+    const uint32_t h = (v * 2654435761U) >> (32 - kLZHashBits);
+    const size_t cand = table[h];
+    table[h] = i + 1;
+    if (cand != 0 && i - (cand - 1) <= kLZMaxOffset && LZRead32(s + cand - 1) == v) {
+      const size_t m = cand - 1;
+      size_t len = kLZMinMatch;
+      while (i + len < n && s[m + len] == s[i + len]) ++len;
+      LZPutSequence(s + anchor, i - anchor, i - m, len, out);
+      i += len; anchor = i; miss = 0;
+    } else {
+      // skip faster over data that does not compress
+      i += 1 + (++miss >> 6);
+    }
+  }
+  LZPutSequence(s + anchor, n - anchor, 0, 0, out);
+}
+/*!
+ * \brief decompress a block, the input is checked so that corrupted data never overruns
+ * \param src compressed content
+ * \param csize number of compressed bytes
+ * \param dst output buffer
+ * \param n exact number of bytes after decompression
+ * \return whether the block is decompressed successfully
+ */
+inline bool LZDecompress(const void *src, size_t csize, void *dst, size_t n) {
+  const unsigned char *ip = static_cast<const unsigned char*>(src);
+  const unsigned char *iend = ip + csize;
+  unsigned char *op = static_cast<unsigned char*>(dst);
+  unsigned char *const obegin = op, *const oend = op + n;
+  while (ip < iend) {
+    const unsigned token = *ip++;
+    size_t lit_len = token >> 4;
+    if (lit_len == 15) {
+      unsigned b;
+      do {
+        if (ip == iend) return false;
+        b = *ip++; lit_len += b;
+      } while (b == 255);
+    }
+    if (lit_len > static_cast<size_t>(iend - ip) || lit_len > static_cast<size_t>(oend - op)) {
+      return false;
+    }
+    std::memcpy(op, ip, lit_len);
+    ip += lit_len; op += lit_len;
+    if (ip == iend) break;
+    if (iend - ip < 2) return false;
+    const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t match_len = (token & 15) + kLZMinMatch;
+    if ((token & 15) == 15) {
+      unsigned b;
+      do {
+        if (ip == iend) return false;
+        b = *ip++; match_len += b;
+      } while (b == 255);
+    }
+    if (offset == 0 || offset > static_cast<size_t>(op - obegin) ||
+        match_len > static_cast<size_t>(oend - op)) {
+      return false;
+    }
+    const unsigned char *m = op - offset;
+    if (offset >= match_len) {
+      std::memcpy(op, m, match_len);
+      op += match_len;
+    } else {
+      // overlapping match repeats the last offset bytes
+      for (size_t k = 0; k < match_len; ++k) *op++ = m[k];
+    }
+  }
+  return op == oend;
+}
+}  // namespace utils
+}  // namespace xgboost
+#endif  // XGBOOST_UTILS_LZ_H_
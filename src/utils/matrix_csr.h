@@ -83,6 +83,86 @@ struct SparseCSRMBuilder {
     findex[rp++] = entry;
   }
 };
+
+/*!
+ * \brief parallel version of SparseCSRMBuilder, each thread counts budget in
+ *        its own histogram, a prefix sum over columns and threads assigns every 
+ *        thread a disjoint range in each column, so elements can be pushed without lock;
+ *        when each thread handles a contiguous range of rows, the elements 
+ *        of each column keep the row order
+ * \tparam IndexType type of index used to store the index position
+ */
+template<typename IndexType>
+struct ParallelSparseCSRMBuilder {
+ private:
+  /*! \brief pointer to each of the col */
+  std::vector<size_t> &cptr;
+  /*! \brief index of nonzero entries in each col */
+  std::vector<IndexType> &findex;
+  /*! \brief budget and then write position of each thread in each col */
+  std::vector< std::vector<size_t> > thread_cptr;
+ public:
+  ParallelSparseCSRMBuilder(std::vector<size_t> &p_cptr,
+                            std::vector<IndexType> &p_findex,
+                            int nthread)
+      : cptr(p_cptr), findex(p_findex), thread_cptr(nthread) {}
+ public:
+  /*! 
+   * \brief step 1: initialize the number of cols in the data, not necessary exact
+   */
+  inline void InitBudget(size_t ncols = 0) {
+    for (size_t i = 0; i < thread_cptr.size(); ++i) {
+      thread_cptr[i].clear();
+      thread_cptr[i].resize(ncols, 0);
+    }
+  }
+  /*! 
+   * \brief step 2: add budget to each cols
+   * \param col_id the id of the col
+   * \param tid id of the thread calling this function
+   * \param nelem number of element budget add to this col
+   */
+  inline void AddBudget(size_t col_id, int tid, size_t nelem = 1) {
+    std::vector<size_t> &tptr = thread_cptr[tid];
+    if (tptr.size() < col_id + 1) {
+      tptr.resize(col_id + 1, 0);
+    }
+    tptr[col_id] += nelem;
+  }
+  /*! \brief step 3: initialize the necessary storage */
+  inline void InitStorage(void) {
+    size_t ncol = 0;
+    for (size_t i = 0; i < thread_cptr.size(); ++i) {
+      ncol = std::max(ncol, thread_cptr[i].size());
+    }
+    for (size_t i = 0; i < thread_cptr.size(); ++i) {
+      thread_cptr[i].resize(ncol, 0);
+    }
+    cptr.clear(); cptr.resize(ncol + 1, 0);
+    size_t start = 0;
+    for (size_t j = 0; j < ncol; ++j) {
+      cptr[j] = start;
+      for (size_t i = 0; i < thread_cptr.size(); ++i) {
+        size_t rlen = thread_cptr[i][j];
+        thread_cptr[i][j] = start;
+        start += rlen;
+      }
+    }
+    cptr[ncol] = start;
+    findex.resize(start);
+  }
+  /*! 
+   * \brief step 4: add new element to each col, the number of calls
+   *        of each thread shall be exactly same as its AddBudget
+   * \param col_id the id of the col
+   * \param entry the element
+   * \param tid id of the thread calling this function
+   */
+  inline void PushElem(size_t col_id, IndexType entry, int tid) {
+    size_t &rp = thread_cptr[tid][col_id];
+    findex[rp++] = entry;
+  }
+};
 }  // namespace utils
 }  // namespace xgboost
 #endif
@@ -0,0 +1,183 @@
+#ifndef XGBOOST_UTILS_MMAP_H_
+#define XGBOOST_UTILS_MMAP_H_
+/*!
+ * \file mmap.h
+ * \brief read-only memory mapped file, and an array type that either owns
+ *        its content or refers to memory owned by someone else, e.g. a mapped file
+ */
+#include <vector>
+#include <cstring>
+#include "./utils.h"
+#ifndef _MSC_VER
+extern "C" {
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+}
+#endif
+
+namespace xgboost {
+namespace utils {
+/*! \brief read-only memory mapping of a whole file */
+class MMapFile {
+ public:
+  MMapFile(void) : dptr_(NULL), size_(0) {}
+  ~MMapFile(void) {
+    this->Close();
+  }
+  /*!
+   * \brief map the file into memory
+   * \param fname name of the file
+   * \return whether the mapping succeeded
+   */
+  inline bool Open(const char *fname) {
+    this->Close();
+#ifdef _MSC_VER
+    return false;
+#else
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd); return false;
+    }
+    void *ptr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) return false;
+    dptr_ = static_cast<const char*>(ptr);
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+#endif
+  }
+  /*! \brief unmap the file */
+  inline void Close(void) {
+#ifndef _MSC_VER
+    if (dptr_ != NULL) munmap(const_cast<char*>(dptr_), size_);
+#endif
+    dptr_ = NULL; size_ = 0;
+  }
+  /*! \return start of mapped memory, NULL if nothing is mapped */
+  inline const char *data(void) const {
+    return dptr_;
+  }
+  /*! \return size of the mapped file */
+  inline size_t size(void) const {
+    return size_;
+  }
+
+ private:
+  // mapping can not be shared between copies
+  MMapFile(const MMapFile &other);
+  MMapFile &operator=(const MMapFile &other);
+  /*! \brief start of mapped memory */
+  const char *dptr_;
+  /*! \brief size of mapped memory */
+  size_t size_;
+};
+
+/*!
+ * \brief vector like array, the content is either owned by the array,
+ *        or is a read-only view of external memory set by SetView;
+ *        any mutation of a view first copies the content into owned storage
+ * \tparam T element type, must be POD
+ */
+template<typename T>
+class MappedArray {
+ public:
+  MappedArray(void) : dptr_(NULL), size_(0), view_(false) {}
+  MappedArray(const MappedArray &other) : dptr_(NULL), size_(0), view_(false) {
+    *this = other;
+  }
+  inline MappedArray &operator=(const MappedArray &other) {
+    if (this == &other) return *this;
+    data_.assign(other.begin(), other.end());
+    view_ = false;
+    this->Sync();
+    return *this;
+  }
+  /*!
+   * \brief let the array refer to external memory, the memory must outlive the view
+   * \param dptr start of the memory
+   * \param size number of elements
+   */
+  inline void SetView(const T *dptr, size_t size) {
+    std::vector<T>().swap(data_);
+    dptr_ = dptr; size_ = size; view_ = true;
+  }
+  /*! \return whether the content is a view of external memory */
+  inline bool IsView(void) const {
+    return view_;
+  }
+  inline size_t size(void) const {
+    return size_;
+  }
+  inline bool empty(void) const {
+    return size_ == 0;
+  }
+  inline const T *begin(void) const {
+    return dptr_;
+  }
+  inline const T *end(void) const {
+    return dptr_ + size_;
+  }
+  inline const T &operator[](size_t i) const {
+    return dptr_[i];
+  }
+  inline const T &back(void) const {
+    return dptr_[size_ - 1];
+  }
+  inline T &operator[](size_t i) {
+    this->Materialize();
+    return data_[i];
+  }
+  inline void push_back(const T &v) {
+    this->Materialize();
+    data_.push_back(v);
+    this->Sync();
+  }
+  inline void resize(size_t n) {
+    this->Materialize();
+    data_.resize(n);
+    this->Sync();
+  }
+  inline void resize(size_t n, const T &v) {
+    this->Materialize();
+    data_.resize(n, v);
+    this->Sync();
+  }
+  inline void clear(void) {
+    data_.clear(); view_ = false;
+    this->Sync();
+  }
+  /*! \brief exchange the content with an owned vector, the array becomes owned */
+  inline void swap(std::vector<T> &vec) {
+    this->Materialize();
+    data_.swap(vec);
+    this->Sync();
+  }
+
+ private:
+  /*! \brief copy the content of a view into owned storage */
+  inline void Materialize(void) {
+    if (!view_) return;
+    data_.assign(dptr_, dptr_ + size_);
+    view_ = false;
+    this->Sync();
+  }
+  inline void Sync(void) {
+    dptr_ = data_.size() == 0 ? NULL : &data_[0];
+    size_ = data_.size();
+  }
+  /*! \brief owned storage */
+  std::vector<T> data_;
+  /*! \brief pointer to the content */
+  const T *dptr_;
+  /*! \brief number of elements */
+  size_t size_;
+  /*! \brief whether the content is a view */
+  bool view_;
+};
+}  // namespace utils
+}  // namespace xgboost
+#endif  // XGBOOST_UTILS_MMAP_H_
@@ -0,0 +1,242 @@
+#ifndef XGBOOST_UTILS_QUANTILE_H_
+#define XGBOOST_UTILS_QUANTILE_H_
+/*!
+ * \file quantile.h
+ * \brief weighted quantile summary and streaming sketch,
+ *        a summary keeps a subset of the values with lower and upper bounds of their weighted rank,
+ *        two summaries can be merged and a summary can be pruned to a given size,
+ *        each merge or prune adds a bounded error to the ranks, so the sketch keeps a binary
+ *        tree of summaries, the error of the final summary is at most eps times the total weight
+ */
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "utils.h"
+
+namespace xgboost {
+namespace utils {
+/*! \brief weighted quantile summary, entries are in increasing order of value */
+struct WQSummary {
+  /*! \brief an entry of the summary */
+  struct Entry {
+    /*! \brief lower bound of the weight of the values smaller than value */
+    double rmin;
+    /*! \brief upper bound of the weight of the values not larger than value */
+    double rmax;
+    /*! \brief weight of value itself, a lower bound */
+    double wmin;
+    /*! \brief the value */
+    float value;
+    Entry(void) {}
+    Entry(double rmin, double rmax, double wmin, float value)
+        : rmin(rmin), rmax(rmax), wmin(wmin), value(value) {}
+    /*! \return lower bound of the weight of the values not larger than value */
+    inline double RMinNext(void) const {
+      return rmin + wmin;
+    }
+    /*! \return upper bound of the weight of the values smaller than value */
+    inline double RMaxPrev(void) const {
+      return rmax - wmin;
+    }
+  };
+  /*! \brief entries of the summary */
+  std::vector<Entry> data;
+  /*! \return number of entries */
+  inline size_t size(void) const {
+    return data.size();
+  }
+  /*! \return total weight of the values summarized */
+  inline double TotalWeight(void) const {
+    return data.size() == 0 ? 0.0 : data.back().rmax;
+  }
+  /*!
+   * \brief make the exact summary of a list of weighted values
+   * \param queue pairs of value and weight, sorted in place
+   */
+  inline void SetFromQueue(std::vector< std::pair<float, double> > *queue) {
+    std::sort(queue->begin(), queue->end());
+    data.clear();
+    double wsum = 0.0;
+    for (size_t i = 0; i < queue->size();) {
+      const float value = (*queue)[i].first;
+      double w = 0.0;
+      for (; i < queue->size() && (*queue)[i].first == value; ++i) {
+        w += (*queue)[i].second;
+      }
+      data.push_back(Entry(wsum, wsum + w, w, value));
+      wsum += w;
+    }
+  }
+  /*!
+   * \brief keep at most maxsize entries of src, chosen to be evenly spread in rank,
+   *        the smallest and largest values are always kept
+   * \param src summary to be pruned, must not be this
+   * \param maxsize maximum number of entries, at least 2
+   */
+  inline void SetPrune(const WQSummary &src, size_t maxsize) {
+    Assert(&src != this, "WQSummary::SetPrune: src can not be the output");
+    if (src.size() <= maxsize) {
+      data = src.data; return;
+    }
+    const std::vector<Entry> &s = src.data;
+    const double begin = s[0].rmax;
+    const double range = s.back().rmin - s[0].rmax;
+    const size_t n = maxsize - 1;
+    data.clear();
+    data.push_back(s[0]);
+    size_t lastidx = 0;
+    for (size_t k = 1, i = 0; k < n; ++k) {
+      // find the entry whose rank interval is the closest to the k-th target rank, compared twice scaled
+      const double dx2 = 2.0 * ((k * range) / n + begin);
+      while (i < s.size() - 1 && dx2 >= s[i + 1].rmax + s[i + 1].rmin) ++i;
+      if (i == s.size() - 1) break;
+      if (dx2 < s[i].RMinNext() + s[i + 1].RMaxPrev()) {
+        if (i != lastidx) {
+          data.push_back(s[i]); lastidx = i;
+        }
+      } else {
+        if (i + 1 != lastidx) {
+          data.push_back(s[i + 1]); lastidx = i + 1;
+        }
+      }
+    }
+    if (lastidx != s.size() - 1) data.push_back(s.back());
+  }
+  /*!
+   * \brief set the summary to the merge of two summaries
+   * \param sa first summary, must not be this
+   * \param sb second summary, must not be this
+   */
+  inline void SetCombine(const WQSummary &sa, const WQSummary &sb) {
+    Assert(&sa != this && &sb != this, "WQSummary::SetCombine: input can not be the output");
+    if (sa.size() == 0) {
+      data = sb.data; return;
+    }
+    if (sb.size() == 0) {
+      data = sa.data; return;
+    }
+    const std::vector<Entry> &a = sa.data, &b = sb.data;
+    data.clear();
+    data.reserve(a.size() + b.size());
+    // rank bounds of the values of one summary that fall between two values of the other
+    double aprev_rmin = 0.0, bprev_rmin = 0.0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+      if (a[i].value == b[j].value) {
+        data.push_back(Entry(a[i].rmin + b[j].rmin, a[i].rmax + b[j].rmax,
+                             a[i].wmin + b[j].wmin, a[i].value));
+        aprev_rmin = a[i].RMinNext(); bprev_rmin = b[j].RMinNext();
+        ++i; ++j;
+      } else if (a[i].value < b[j].value) {
+        data.push_back(Entry(a[i].rmin + bprev_rmin, a[i].rmax + b[j].RMaxPrev(),
+                             a[i].wmin, a[i].value));
+        aprev_rmin = a[i].RMinNext();
+        ++i;
+      } else {
+        data.push_back(Entry(b[j].rmin + aprev_rmin, b[j].rmax + a[i].RMaxPrev(),
+                             b[j].wmin, b[j].value));
+        bprev_rmin = b[j].RMinNext();
+        ++j;
+      }
+    }
+    for (; i < a.size(); ++i) {
+      data.push_back(Entry(a[i].rmin + bprev_rmin, a[i].rmax + b.back().rmax, a[i].wmin, a[i].value));
+    }
+    for (; j < b.size(); ++j) {
+      data.push_back(Entry(b[j].rmin + aprev_rmin, b[j].rmax + a.back().rmax, b[j].wmin, b[j].value));
+    }
+  }
+  /*! \return maximum error of the rank of a query, the largest gap between neighboring bounds */
+  inline double MaxError(void) const {
+    double res = 0.0;
+    for (size_t i = 0; i < data.size(); ++i) {
+      res = std::max(res, data[i].rmax - data[i].rmin - data[i].wmin);
+      if (i != 0) res = std::max(res, data[i].rmax - data[i - 1].rmin - data[i].wmin - data[i - 1].wmin);
+    }
+    return res;
+  }
+};
+
+/*!
+ * \brief streaming weighted quantile sketch,
+ *        values are buffered and summarized in blocks, the block summaries are merged
+ *        like a binary counter, level l holds the summary of 2^l blocks
+ */
+class WQuantileSketch {
+ public:
+  WQuantileSketch(void) : limit_size_(2) {}
+  /*!
+   * \brief get ready for a new stream
+   * \param maxn upper bound of the number of values to be pushed
+   * \param eps error bound relative to the total weight
+   */
+  inline void Init(size_t maxn, double eps) {
+    limit_size_ = LimitSize(maxn, eps);
+    inqueue_.clear();
+    levels_.clear();
+  }
+  /*!
+   * \brief size a summary is pruned to for a stream of at most maxn values and error eps,
+   *        every level of merging adds the error of one prune, so eps is shared by the levels
+   */
+  inline static size_t LimitSize(size_t maxn, double eps) {
+    Check(eps > 0.0 && eps < 1.0, "WQuantileSketch: eps must be in (0, 1)");
+    size_t nlevel = 1, limit;
+    while (true) {
+      limit = static_cast<size_t>(std::ceil(nlevel / eps)) + 1;
+      if ((static_cast<size_t>(1) << nlevel) * limit >= maxn || nlevel >= 60) break;
+      ++nlevel;
+    }
+    return limit;
+  }
+  /*! \brief add a value with weight */
+  inline void Push(float value, double weight) {
+    inqueue_.push_back(std::make_pair(value, weight));
+    if (inqueue_.size() >= limit_size_ * 2) this->Flush();
+  }
+  /*! \brief get the summary of all the values pushed, the sketch can not be used afterwards */
+  inline void GetSummary(WQSummary *out) {
+    this->Flush();
+    out->data.clear();
+    WQSummary temp;
+    for (size_t l = 0; l < levels_.size(); ++l) {
+      if (levels_[l].size() == 0) continue;
+      temp.SetCombine(*out, levels_[l]);
+      out->SetPrune(temp, limit_size_);
+    }
+  }
+  /*! \return number of entries a summary is pruned to */
+  inline size_t limit_size(void) const {
+    return limit_size_;
+  }
+
+ private:
+  /*! \brief summarize the buffered values and carry the summary into the levels */
+  inline void Flush(void) {
+    if (inqueue_.size() == 0) return;
+    WQSummary exact, temp;
+    exact.SetFromQueue(&inqueue_);
+    inqueue_.clear();
+    WQSummary carry;
+    carry.SetPrune(exact, limit_size_);
+    for (size_t l = 0;; ++l) {
+      if (l == levels_.size()) levels_.push_back(WQSummary());
+      if (levels_[l].size() == 0) {
+        levels_[l].data.swap(carry.data); return;
+      }
+      temp.SetCombine(levels_[l], carry);
+      levels_[l].data.clear();
+      carry.SetPrune(temp, limit_size_);
+    }
+  }
+  /*! \brief maximum size of a summary */
+  size_t limit_size_;
+  /*! \brief values not summarized yet */
+  std::vector< std::pair<float, double> > inqueue_;
+  /*! \brief summary of each level */
+  std::vector<WQSummary> levels_;
+};
+}  // namespace utils
+}  // namespace xgboost
+#endif  // XGBOOST_UTILS_QUANTILE_H_
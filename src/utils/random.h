@@ -10,6 +10,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <vector>
+#include <algorithm>
 
 #ifdef _MSC_VER
 typedef unsigned char uint8_t;
@@ -26,6 +27,48 @@ namespace random{
 inline void Seed(uint32_t seed) {
   srand(seed);
 }
+/*! \brief return a real number uniform in [0,1) */
+inline double NextDouble(void) {
+  return static_cast<double>(rand()) / (static_cast<double>(RAND_MAX) + 1.0);
+}
+/*! \brief return 1 with probability p, 0 otherwise */
+inline uint32_t SampleBinary(double p) {
+  return NextDouble() < p;
+}
+/*! \brief random shuffle of the elements */
+template<typename T>
+inline void Shuffle(std::vector<T> &data) {
+  for (size_t i = data.size(); i > 1; --i) {
+    const size_t j = static_cast<size_t>(NextDouble() * i);
+    std::swap(data[i - 1], data[j]);
+  }
+}
+
+/*!
+ * \brief PRNG with a state of its own, used by concurrent tasks so that
+ *        the numbers drawn by a task do not depend on how the tasks are scheduled
+ */
+class Random {
+ public:
+  explicit Random(uint32_t seed = 0) : state_(seed) {}
+  /*! \brief return a real number uniform in [0,1) */
+  inline double NextDouble(void) {
+    // 64 bit LCG of Knuth, the higher 53 bits are used
+    state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<double>(state_ >> 11) / 9007199254740992.0;
+  }
+  /*! \brief random shuffle of the elements */
+  template<typename T>
+  inline void Shuffle(std::vector<T> &data) {
+    for (size_t i = data.size(); i > 1; --i) {
+      const size_t j = static_cast<size_t>(this->NextDouble() * i);
+      std::swap(data[i - 1], data[j]);
+    }
+  }
+
+ private:
+  uint64_t state_;
+};
 
 }  // namespace random
 }  // namespace xgboost
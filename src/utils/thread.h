@@ -0,0 +1,103 @@
+#ifndef XGBOOST_UTILS_THREAD_H_
+#define XGBOOST_UTILS_THREAD_H_
+/*!
+ * \file thread.h
+ * \brief thin wrappers of pthread, used by background workers such as page prefetching,
+ *        data parallel loops should use OpenMP instead
+ */
+#include <pthread.h>
+#include "./utils.h"
+
+namespace xgboost {
+namespace utils {
+/*! \brief mutual exclusion lock */
+class Mutex {
+ public:
+  Mutex(void) {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+  ~Mutex(void) {
+    pthread_mutex_destroy(&mutex_);
+  }
+  inline void Lock(void) {
+    pthread_mutex_lock(&mutex_);
+  }
+  inline void Unlock(void) {
+    pthread_mutex_unlock(&mutex_);
+  }
+
+ private:
+  friend class ConditionVariable;
+  Mutex(const Mutex &other);
+  Mutex &operator=(const Mutex &other);
+  pthread_mutex_t mutex_;
+};
+
+/*! \brief lock a mutex during the lifetime of the object */
+class LockGuard {
+ public:
+  explicit LockGuard(Mutex &mutex) : mutex_(mutex) {
+    mutex_.Lock();
+  }
+  ~LockGuard(void) {
+    mutex_.Unlock();
+  }
+
+ private:
+  Mutex &mutex_;
+};
+
+/*! \brief condition variable */
+class ConditionVariable {
+ public:
+  ConditionVariable(void) {
+    pthread_cond_init(&cond_, NULL);
+  }
+  ~ConditionVariable(void) {
+    pthread_cond_destroy(&cond_);
+  }
+  /*! \brief wait for a signal, mutex must be locked by the caller */
+  inline void Wait(Mutex &mutex) {
+    pthread_cond_wait(&cond_, &mutex.mutex_);
+  }
+  inline void Signal(void) {
+    pthread_cond_signal(&cond_);
+  }
+  inline void Broadcast(void) {
+    pthread_cond_broadcast(&cond_);
+  }
+
+ private:
+  ConditionVariable(const ConditionVariable &other);
+  ConditionVariable &operator=(const ConditionVariable &other);
+  pthread_cond_t cond_;
+};
+
+/*! \brief a joinable thread */
+class Thread {
+ public:
+  Thread(void) : started_(false) {}
+  /*!
+   * \brief start the thread
+   * \param entry entry function of the thread
+   * \param arg argument passed to entry
+   */
+  inline void Start(void *(*entry)(void*), void *arg) {
+    Assert(!started_, "Thread: already started");
+    Check(pthread_create(&thread_, NULL, entry, arg) == 0, "Thread: fail to create thread");
+    started_ = true;
+  }
+  /*! \brief wait for the thread to finish */
+  inline void Join(void) {
+    if (!started_) return;
+    pthread_join(thread_, NULL);
+    started_ = false;
+  }
+
+ private:
+  pthread_t thread_;
+  bool started_;
+};
+}  // namespace utils
+}  // namespace xgboost
+#endif  // XGBOOST_UTILS_THREAD_H_
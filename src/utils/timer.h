@@ -0,0 +1,27 @@
+#ifndef XGBOOST_UTILS_TIMER_H_
+#define XGBOOST_UTILS_TIMER_H_
+/*!
+ * \file timer.h
+ * \brief wall clock timer used to report speed of the different phases
+ */
+#ifdef _MSC_VER
+#include <ctime>
+#else
+#include <time.h>
+#endif
+
+namespace xgboost {
+namespace utils {
+/*! \return current wall clock time in seconds */
+inline double GetTime(void) {
+#ifdef _MSC_VER
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+#endif
+}
+}  // namespace utils
+}  // namespace xgboost
+#endif  // XGBOOST_UTILS_TIMER_H_
@@ -4,11 +4,14 @@
 #include <ctime>
 #include <string>
 #include <cstring>
+#include <algorithm>
 #include "./learner/learner-inl.h"
 #include "./learner/dmatrix.h"
 #include "./utils/fmap.h"
 #include "./utils/random.h"
 #include "./utils/config.h"
+#include "./utils/omp.h"
+#include "./utils/thread.h"
 
 namespace xgboost {
 /*!
@@ -66,6 +69,7 @@ typedef learner::DMatrix DMatrix;
       eval_data_paths.push_back(std::string(val));
     }
     learner.SetParam(name, val);
+    cfg_data.push_back(std::make_pair(std::string(name), std::string(val)));
     printf("Set Param %s = %s\n", name, val);
   }
  public:
@@ -94,19 +98,75 @@ typedef learner::DMatrix DMatrix;
   inline void InitData (void) {
     if (name_fmap != "NULL") fmap.LoadText(name_fmap.c_str());
     if (task == "dump") return;
+    this->ConfigData(&data);
     if (task == "pred" || task == "dumppath") {
       data.CacheLoad(test_path.c_str(), silent!=0, use_buffer!=0);
     } else {
-      // training 
-      data.CacheLoad(train_path.c_str(), silent!=0, use_buffer!=0);
+      // training, evaluation data is loaded by worker threads concurrently,
+      // except data that shares its file with an earlier matrix, as they would write the same buffer
       utils::Assert(eval_data_names.size() == eval_data_paths.size());
-      for (size_t i = 0; i < eval_data_names.size(); ++i) {
+      std::vector<LoadJob> jobs(eval_data_paths.size());
+      std::vector<utils::Thread> workers(eval_data_paths.size());
+      std::vector<bool> shared(eval_data_paths.size(), false);
+      int nload = 1;
+      for (size_t i = 0; i < eval_data_paths.size(); ++i) {
+        shared[i] = eval_data_paths[i] == train_path;
+        for (size_t j = 0; j < i; ++j) {
+          if (eval_data_paths[i] == eval_data_paths[j]) shared[i] = true;
+        }
+        if (!shared[i]) ++nload;
+      }
+      // the concurrent loads split the threads, each of them parses with its share
+      const int nthread = omp_get_max_threads();
+      const int nthread_load = std::max(nthread / nload, 1);
+      for (size_t i = 0; i < eval_data_paths.size(); ++i) {
         deval.push_back(new DMatrix());
-        deval.back()->CacheLoad(eval_data_paths[i].c_str(), silent!=0, use_buffer!=0);
+        this->ConfigData(deval.back());
+        jobs[i].dmat = deval.back();
+        jobs[i].path = eval_data_paths[i].c_str();
+        jobs[i].silent = silent != 0;
+        jobs[i].use_buffer = use_buffer != 0;
+        jobs[i].nthread = shared[i] ? nthread : nthread_load;
+        if (!shared[i]) workers[i].Start(LoadEntry, &jobs[i]);
+      }
+      omp_set_num_threads(nthread_load);
+      data.CacheLoad(train_path.c_str(), silent!=0, use_buffer!=0, true);
+      omp_set_num_threads(nthread);
+      for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].Join();
+      }
+      for (size_t i = 0; i < deval.size(); ++i) {
+        if (shared[i]) LoadEntry(&jobs[i]);
       }
     }
     learner.SetData(&data, deval, eval_data_names);
   }
+  /*! \brief a matrix to be loaded by a worker thread */
+  struct LoadJob {
+    DMatrix *dmat;
+    const char *path;
+    bool silent, use_buffer;
+    /*! \brief number of threads used to load the matrix */
+    int nthread;
+  };
+  /*! \brief entry of worker threads that load data */
+  inline static void *LoadEntry(void *arg) {
+    LoadJob *job = static_cast<LoadJob*>(arg);
+    // OpenMP setting is per thread, a worker does not see the nthread of the main thread
+    omp_set_num_threads(job->nthread);
+    job->dmat->CacheLoad(job->path, job->silent, job->use_buffer);
+    return NULL;
+  }
+  /*! \brief pass the parameters to data matrix */
+  inline void ConfigData(DMatrix *dmat) {
+    for (size_t i = 0; i < cfg_data.size(); ++i) {
+      dmat->SetParam(cfg_data[i].first.c_str(), cfg_data[i].second.c_str());
+    }
+    // the matrix may be opened by a worker thread, tell it the number of threads that train on it
+    char nthread[32];
+    sprintf(nthread, "%d", omp_get_max_threads());
+    dmat->SetParam("nthread", nthread);
+  }
   inline void InitLearner(void) {
     if (model_in != "NULL") {
       utils::FileStream fi(utils::FopenCheck(model_in.c_str(), "rb"));
@@ -197,6 +257,8 @@ typedef learner::DMatrix DMatrix;
   std::vector<std::string> eval_data_paths;            
   /* \brief the names of the evaluation data used in output log */
   std::vector<std::string> eval_data_names;            
+  /* \brief parameters passed to data matrix */
+  std::vector< std::pair<std::string, std::string> > cfg_data;
  private:
   DMatrix data;
   std::vector<DMatrix*> deval;